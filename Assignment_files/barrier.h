@@ -0,0 +1,33 @@
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#include <condition_variable>
+#include <mutex>
+
+// All parties block in wait() until the last one arrives. Used to step
+// worker threads in lockstep: per epoch in multicore.h, per trace window
+// in sweep.h.
+class EpochBarrier {
+private:
+    std::mutex lock;
+    std::condition_variable cv;
+    int parties, waiting;
+    unsigned long generation;
+
+public:
+    explicit EpochBarrier(int n) : parties(n), waiting(0), generation(0) {}
+
+    void wait() {
+        std::unique_lock<std::mutex> guard(lock);
+        unsigned long g = generation;
+        if (++waiting == parties) {
+            waiting = 0;
+            generation++;
+            cv.notify_all();
+            return;
+        }
+        cv.wait(guard, [&]() { return generation != g; });
+    }
+};
+
+#endif
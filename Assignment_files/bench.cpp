@@ -0,0 +1,309 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include "cache_sim.cc"
+#include "trace.h"
+#include "pipeline.h"
+#include "composed.h"
+
+///////////////////////////////////////////////////////////////////////////
+// Simulator throughput benchmarks (make bench)
+//
+//    Times the simulator core on synthetic access streams and on
+//    gcc_trace.txt replayed many times, plus VictimCache::findBlock and
+//    trace decoding. Every line reports accesses/second, ns/access and
+//    heap allocations/access (counted by the operator new below).
+//
+//    Finally every ref_outputs/gcc.output*.txt is re-simulated and its raw
+//    a-p statistics compared with ours, and a block number too wide for
+//    the packed metadata is checked not to hit an empty way, nor one a
+//    prefetcher steps to past block 0 to be prefetched; the exit
+//    status is non-zero if any check fails.
+///////////////////////////////////////////////////////////////////////////
+
+static std::atomic<unsigned long> numAllocations(0);
+
+// Out of line, or GCC pairs the inlined malloc/free with new/delete and
+// warns. With PROFILE=1 it also feeds the per-stage counts of profile.h.
+__attribute__((noinline)) void *operator new(size_t n) {
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+#ifdef CACHE_SIM_PROFILE
+    if (profileThreadData) profileThreadData->allocations++;
+#endif
+    void *p = malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+__attribute__((noinline)) void operator delete(void *p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept { free(p); }
+
+static unsigned long allocationCount() { return numAllocations.load(); }
+
+#define BENCH_ACCESSES 4000000
+#define BENCH_GCC_REPEAT 100
+
+typedef ComposedHierarchy<LRUPolicy, ComposedLevels<LRUPolicy>::L1> ComposedL1;
+typedef ComposedHierarchy<LRUPolicy, ComposedLevels<LRUPolicy>::L1VCL2> ComposedFull;
+
+// Time body(), which performs n accesses, and print one result line
+template <class F>
+void measure(const std::string &name, unsigned long n, F body) {
+    unsigned long allocsBefore = allocationCount();
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto stop = std::chrono::steady_clock::now();
+    unsigned long allocs = allocationCount() - allocsBefore;
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    printf("  %-40s %10.2f M acc/s %8.2f ns/acc %8.4f allocs/acc\n", name.c_str(),
+           n / seconds / 1e6, seconds * 1e9 / n, (double)allocs / n);
+}
+
+// Synthetic streams, 30% writes, deterministic
+static std::vector<Access> makeStream(const std::string &kind, unsigned long n) {
+    std::vector<Access> stream(n);
+    unsigned long long seed = 12345;
+    auto rng = [&]() {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return seed;
+    };
+    unsigned long address = 0x10000000;
+    for (unsigned long i = 0; i < n; ++i) {
+        if (kind == "sequential") address += 4;
+        else if (kind == "strided") address += 4096 + 64;
+        else if (kind == "random") address = 0x10000000 + (rng() % (64 << 20));
+        else {
+            // hot-set: 90% of accesses inside a 4KB region
+            unsigned long r = rng();
+            address = (r % 10) ? 0x10000000 + (r >> 8) % 4096 : 0x20000000 + (r >> 8) % (64 << 20);
+        }
+        stream[i] = Access{address, (rng() % 10 < 3) ? 'w' : 'r'};
+    }
+    return stream;
+}
+
+// H is Hierarchy (pointer-linked BasicCaches) or a ComposedHierarchy
+template <class H = Hierarchy>
+static void benchHierarchy(const std::string &label, const CacheConfig &cfg, const std::vector<Access> &stream,
+                           unsigned long repeat = 1) {
+    H h(cfg);
+    measure(label, stream.size() * repeat, [&]() {
+        for (unsigned long r = 0; r < repeat; ++r) {
+            for (const Access &a : stream) h.access(a.type, a.address);
+        }
+    });
+}
+
+// The same through H::access(records, n), i.e. CacheLevel::handleBatch
+template <class H = Hierarchy>
+static void benchBatch(const std::string &label, const CacheConfig &cfg, const std::vector<Access> &stream,
+                       unsigned long repeat = 1) {
+    H h(cfg);
+    measure(label, stream.size() * repeat, [&]() {
+        for (unsigned long r = 0; r < repeat; ++r) h.access(stream.data(), stream.size());
+    });
+}
+
+static void benchVictimCache(int entries) {
+    VictimCache vc(entries, 16);
+    for (int i = 0; i < entries; ++i) {
+        CacheBlock b;
+        b.tag = i * 7;
+        b.valid = true;
+        vc.insert(b);
+    }
+    unsigned long n = BENCH_ACCESSES / 4;
+    std::vector<unsigned long> probes(n);
+    unsigned long long seed = 99;
+    for (unsigned long i = 0; i < n; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        probes[i] = (seed % (2 * entries)) * 7; // about half of them hit
+    }
+    unsigned long hits = 0;
+    measure("VictimCache::findBlock " + std::to_string(entries) + " entries", n, [&]() {
+        for (unsigned long t : probes) hits += vc.findBlock(t);
+    });
+    if (hits == 0) std::cout << "  (no VC hits)\n";
+}
+
+static void benchParsing(const std::string &trace_file) {
+    std::ifstream in(trace_file);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(in, line)) lines.push_back(line);
+    unsigned long n = lines.size() * 20;
+
+    unsigned long sum = 0;
+    measure("parse: istringstream + stoull", n, [&]() {
+        for (int r = 0; r < 20; ++r) {
+            for (const std::string &l : lines) {
+                char type;
+                std::string address_str;
+                std::istringstream iss(l);
+                iss >> type >> address_str;
+                sum += std::stoull(address_str, nullptr, 16);
+            }
+        }
+    });
+    measure("parse: parseTraceLine", n, [&]() {
+        for (int r = 0; r < 20; ++r) {
+            for (const std::string &l : lines) {
+                char type;
+                unsigned long address = 0;
+                parseTraceLine(l.c_str(), type, address);
+                sum += address;
+            }
+        }
+    });
+    measure("parse: TracePipeline (" + trace_file + ")", lines.size(), [&]() {
+        forEachTraceAccess(trace_file, [&](char, unsigned long address) { sum += address; });
+    });
+    if (sum == 42) std::cout << "\n"; // keep the loops from being optimized out
+}
+
+// Raw a-p statistics, in the same order and rounding as the reference output
+static std::vector<std::string> rawStats(const SimStats &s) {
+    char buffer[64];
+    std::vector<std::string> v;
+    auto num = [&](long x) { v.push_back(std::to_string(x)); };
+    auto rate = [&](double x) {
+        snprintf(buffer, sizeof(buffer), "%.4f", x);
+        v.push_back(buffer);
+    };
+    num(s.l1Reads); num(s.l1ReadMisses); num(s.l1Writes); num(s.l1WriteMisses);
+    num(s.swapRequests); rate(s.swapRequestRate()); num(s.swaps); rate(s.l1MissRate());
+    num(s.l1Writebacks); num(s.l2Reads); num(s.l2ReadMisses); num(s.l2Writes);
+    num(s.l2WriteMisses); rate(s.l2MissRate()); num(s.l2Writebacks); num(s.memoryTraffic());
+    return v;
+}
+
+// Re-simulate every reference output; returns the number of mismatching files
+static int checkReferenceOutputs(const std::vector<Access> &gcc) {
+    int failures = 0;
+    for (int i = 0; i < 8; ++i) {
+        std::string path = "ref_outputs/gcc.output" + std::to_string(i) + ".txt";
+        std::ifstream in(path);
+        if (!in) {
+            std::cout << "  " << path << ": missing\n";
+            failures++;
+            continue;
+        }
+        CacheConfig cfg = {0, 0, 0, 0, 0, 0};
+        std::vector<std::string> expected;
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream iss(line);
+            std::string key, value;
+            iss >> key;
+            if (key == "L1_SIZE:") iss >> cfg.L1_SIZE;
+            else if (key == "L1_ASSOC:") iss >> cfg.L1_ASSOC;
+            else if (key == "L1_BLOCKSIZE:") iss >> cfg.L1_BLOCKSIZE;
+            else if (key == "VC_NUM_BLOCKS:") iss >> cfg.VC_NUM_BLOCKS;
+            else if (key == "L2_SIZE:") iss >> cfg.L2_SIZE;
+            else if (key == "L2_ASSOC:") iss >> cfg.L2_ASSOC;
+            else if (key.size() == 2 && key[1] == '.' && key[0] >= 'a' && key[0] <= 'p') {
+                size_t pos = line.find_last_of(" \t");
+                expected.push_back(line.substr(pos + 1));
+            }
+        }
+
+        Hierarchy h(cfg);
+        for (const Access &a : gcc) h.access(a.type, a.address);
+        std::vector<std::string> actual = rawStats(SimStats(h));
+
+        std::string bad;
+        for (size_t k = 0; k < actual.size() && k < expected.size(); ++k) {
+            if (actual[k] != expected[k]) {
+                bad += std::string(bad.empty() ? "" : ", ") + (char)('a' + k) + " " + actual[k] + " != " + expected[k];
+            }
+        }
+        if (expected.size() != actual.size()) bad += " (expected " + std::to_string(expected.size()) + " fields)";
+        std::cout << "  " << path << ": " << (bad.empty() ? "match" : "MISMATCH " + bad) << "\n";
+        if (!bad.empty()) failures++;
+    }
+    return failures;
+}
+
+// A block number too wide for the packed metadata must never hit an
+// empty way (fresh, or cleared by an invalidation), so that it reaches
+// the overflow check when it is filled; returns 1 if it does hit
+static int checkWideTags() {
+    Cache cache(1024, 64, 16); // one set, so the whole block number is stored
+    unsigned long wide = cache.getTag(0xffffffffffffff00UL);
+    CacheBlock block;
+    bool hit = cache.set(0).findBlock(wide, block) || cache.set(0).contains(wide);
+    cache.handleRead(0); // block 0 has a zero quotient
+    cache.invalidate(0);
+    hit = hit || cache.set(0).findBlock(wide, block) || cache.set(0).contains(wide);
+    std::cout << "  block number " << wide << " on 1 set of 64 ways: " << (hit ? "FALSE HIT" : "no false hit") << "\n";
+    return hit ? 1 : 0;
+}
+
+// A descending stride reaching block 0 must not prefetch the wrapped
+// blocks past it (they don't fit the metadata, and fill() would fail
+// the run); returns 1 if it does
+static int checkPrefetchWrap() {
+    Cache cache(16384, 1024, 16); // one set, as wide as fits
+    StridePrefetcher stride(4);
+    cache.setPrefetcher(&stride);
+    const unsigned long addresses[] = {0x40, 0x20, 0x0, 0x1000};
+    for (unsigned long a : addresses) cache.handleRead(a);
+    bool wrapped = stride.stats.issued != 0;
+    std::cout << "  descending stride to block 0: " << stride.stats.issued << " prefetches issued"
+              << (wrapped ? " (WRAPPED)" : "") << "\n";
+    return wrapped ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    std::string trace_file = argc > 1 ? argv[1] : "gcc_trace.txt";
+    std::vector<Access> gcc;
+    if (!loadTrace(trace_file, gcc)) {
+        std::cerr << "Error opening trace file: " << trace_file << "\n";
+        return EXIT_FAILURE;
+    }
+
+    const CacheConfig l1Only = {32768, 8, 64, 0, 0, 0};
+    const CacheConfig full = {1024, 2, 16, 16, 8192, 4};
+
+    std::cout << "===== Synthetic streams (" << BENCH_ACCESSES << " accesses) =====\n";
+    const char *kinds[] = {"sequential", "strided", "random", "hot-set"};
+    for (const char *kind : kinds) {
+        std::vector<Access> stream = makeStream(kind, BENCH_ACCESSES);
+        benchHierarchy(std::string(kind) + ", L1 32K/8/64", l1Only, stream);
+        benchHierarchy(std::string(kind) + ", L1 1K/2/16+VC16+L2 8K/4", full, stream);
+        benchHierarchy<ComposedFull>(std::string(kind) + ", composed 1K/2/16+VC16+L2 8K/4", full, stream);
+        benchBatch<ComposedFull>(std::string(kind) + ", composed batch 1K/2/16+VC16+L2 8K/4", full, stream);
+    }
+
+    std::cout << "===== " << trace_file << " x" << BENCH_GCC_REPEAT << " =====\n";
+    benchHierarchy("gcc, L1 32K/8/64", l1Only, gcc, BENCH_GCC_REPEAT);
+    benchHierarchy<ComposedL1>("gcc, composed L1 32K/8/64", l1Only, gcc, BENCH_GCC_REPEAT);
+    benchBatch<ComposedL1>("gcc, composed batch L1 32K/8/64", l1Only, gcc, BENCH_GCC_REPEAT);
+    benchHierarchy("gcc, L1 1K/2/16+VC16+L2 8K/4", full, gcc, BENCH_GCC_REPEAT);
+    benchHierarchy<ComposedFull>("gcc, composed 1K/2/16+VC16+L2 8K/4", full, gcc, BENCH_GCC_REPEAT);
+    benchBatch<ComposedFull>("gcc, composed batch 1K/2/16+VC16+L2 8K/4", full, gcc, BENCH_GCC_REPEAT);
+
+    std::cout << "===== Victim cache =====\n";
+    benchVictimCache(16);
+    benchVictimCache(256);
+
+    std::cout << "===== Trace parsing =====\n";
+    benchParsing(trace_file);
+
+    std::cout << "===== Reference outputs =====\n";
+    int failures = checkReferenceOutputs(gcc);
+    std::cout << "===== Wide block numbers =====\n";
+    failures += checkWideTags();
+    failures += checkPrefetchWrap();
+    std::cout << (failures ? std::to_string(failures) + " check(s) failed\n" : "all checks pass\n");
+    return failures ? EXIT_FAILURE : 0;
+}
@@ -1,16 +1,34 @@
+#include <cstdlib>
 #include <vector>
-#include <list>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <type_traits>
+#include "replacement.h"
+#include "tag_index.h"
+#include "event_queue.h"
+#include "classify.h"
+#include "profile.h"
+#include "checkpoint.h"
+#include "prefetch.h"
+#include "writebuffer.h"
+
+#define CACHE_BATCH 64             // accesses decoded at once by handleBatch
+#define CACHE_PREFETCH_DISTANCE 4  // accesses between a set's prefetch and its lookup
+#define NO_LAST_TAG (~0UL)         // no tag can be this: it doesn't fit the packed metadata
 
 class CacheBlock {
 public:
     unsigned long tag; // Tag for the block
     bool valid;        // Is the block valid?
     bool dirty;        // Is the block dirty (for write-back)?
+    bool prefetched;   // Filled by a prefetch and not demanded yet?
 
-    CacheBlock() : tag(0), valid(false), dirty(false) {}
-    CacheBlock(int tag_) : tag(tag_), valid(false), dirty(false) {}
+    CacheBlock() : tag(0), valid(false), dirty(false), prefetched(false) {}
+    CacheBlock(int tag_) : tag(tag_), valid(false), dirty(false), prefetched(false) {}
 
     void invalidate() {
         valid = false;
@@ -19,161 +37,683 @@ public:
 };
 
 
+// Fully associative LRU victim cache.
+//
+// Entries live in a preallocated array threaded on an intrusive doubly
+// linked recency list (head = MRU), and a TagIndex finds a block without
+// scanning, so lookup, swap and eviction are O(1) and never allocate.
+// A tag is buffered at most once: insert() replaces an older copy of the
+// same tag, so the index always names the only slot holding it.
 class VictimCache {
 private:
+    enum { NIL = -1 };
+
     int numBlocks;
-    std::list<CacheBlock> blocks;
     int blockSize;
+    std::vector<CacheBlock> blocks; // slot storage
+    std::vector<int> prev, next;    // recency list links
+    int head, tail;                 // MRU and LRU slots
+    int count;                      // slots on the recency list
+    int freeList;                   // unused slots, linked through next
+
+    TagIndex index;                 // tag -> most recent slot holding it
+
+    void unlink(int slot) {
+        if (prev[slot] != NIL) next[prev[slot]] = next[slot];
+        else head = next[slot];
+        if (next[slot] != NIL) prev[next[slot]] = prev[slot];
+        else tail = prev[slot];
+        count--;
+    }
+    void pushFront(int slot) {
+        prev[slot] = NIL;
+        next[slot] = head;
+        if (head != NIL) prev[head] = slot;
+        else tail = slot;
+        head = slot;
+        count++;
+    }
+    // Take slot off the list and out of the index
+    void release(int slot) {
+        if (blocks[slot].valid) index.erase(blocks[slot].tag);
+        unlink(slot);
+        next[slot] = freeList;
+        freeList = slot;
+    }
+
 public:
-    VictimCache(int nblocks,int blockSize) : numBlocks(nblocks),blockSize(blockSize) {
-        for (int i = 0; i < numBlocks; ++i) {
-            blocks.push_back(CacheBlock());
-        }
-        // std::cout<<blocks.size();
+    VictimCache(int nblocks,int blockSize)
+        : numBlocks(nblocks), blockSize(blockSize), blocks(nblocks), prev(nblocks, (int)NIL), next(nblocks, (int)NIL),
+          head(NIL), tail(NIL), count(0), freeList(NIL), index(nblocks) {
+        // Starts out full of invalid blocks, like the original list
+        for (int i = numBlocks - 1; i >= 0; --i) pushFront(i);
     }
 
+    // Whether tag is buffered, without touching the recency order
+    bool contains(unsigned long tag) const { return index.find(tag) != NIL; }
+
     bool findBlock(unsigned long tag) {
-        for (auto it = blocks.begin(); it != blocks.end(); ++it) {
-            if (it->valid && it->tag == tag) {
-                blocks.splice(blocks.begin(), blocks, it); // Move to front (MRU)
-                return true;
-            }
+        int slot = index.find(tag);
+        if (slot == NIL) return false;
+        if (slot != head) {
+            unlink(slot);
+            pushFront(slot); // Move to front (MRU)
         }
-        return false;
+        return true;
     }
 
-    void swapBlock(unsigned long tag, CacheBlock evictedBlock) {
-        // Insert the evicted block into VC (LRU)
-        insert(evictedBlock);
+    // Remove the block holding tag into out, for a swap into L1; returns
+    // false if it isn't buffered. Its slot takes the next insertion.
+    bool take(unsigned long tag, CacheBlock& out) {
+        int slot = index.find(tag);
+        if (slot == NIL) return false;
+        out = blocks[slot];
+        release(slot);
+        return true;
     }
 
-    void insert(CacheBlock block) {
-        if (blocks.size() == numBlocks) {
-            blocks.pop_back(); // Evict LRU block
+    // Insert block as MRU; returns the LRU block it pushed out (invalid if
+    // there was a free slot). An older copy of the tag is dropped, its
+    // dirty bit carried over, so the tag stays buffered once.
+    CacheBlock insert(CacheBlock block) {
+        CacheBlock evicted;
+        int old = block.valid ? index.find(block.tag) : NIL;
+        if (old != NIL) {
+            block.dirty = block.dirty || blocks[old].dirty;
+            release(old);
+        }
+        if (count == numBlocks) {
+            if (tail == NIL) return block; // zero-entry buffer
+            evicted = blocks[tail];
+            release(tail); // Evict LRU block
+        }
+        int slot = freeList;
+        freeList = next[slot];
+        blocks[slot] = block;
+        pushFront(slot); // Insert new block as MRU
+        if (block.valid) index.set(block.tag, slot);
+        return evicted;
+    }
+    // Drop tag (coherence invalidation); returns the block dropped,
+    // invalid if there was none. The freed slot takes the next insertion.
+    CacheBlock invalidate(unsigned long tag) {
+        CacheBlock dropped;
+        dropped.tag = tag;
+        int slot = index.find(tag);
+        if (slot != NIL) {
+            dropped = blocks[slot];
+            release(slot);
         }
-        blocks.push_front(block); // Insert new block as MRU
+        return dropped;
     }
     bool evictBlock(unsigned long &evictedAddress, bool &evictedDirty) {
-        if (blocks.empty()) return false;
-        auto& block = blocks.front();
-        evictedAddress = block.tag;
-        evictedDirty = block.dirty;
-        blocks.erase(blocks.begin());
+        if (head == NIL) return false;
+        evictedAddress = blocks[head].tag;
+        evictedDirty = blocks[head].dirty;
+        release(head);
+        return true;
+    }
+    // Entries MRU first, as (tag, valid, dirty); see checkpoint.h
+    void saveState(CheckpointWriter& out) const {
+        out.put((int32_t)count);
+        for (int i = head; i != NIL; i = next[i]) {
+            out.put((uint64_t)blocks[i].tag);
+            out.put((uint8_t)blocks[i].valid);
+            out.put((uint8_t)blocks[i].dirty);
+        }
+    }
+    bool loadState(CheckpointReader& in) {
+        int32_t n;
+        if (!in.get(n) || n < 0 || n > numBlocks) return false;
+        std::vector<CacheBlock> saved(n);
+        for (CacheBlock& b : saved) {
+            uint64_t tag;
+            uint8_t valid, dirty;
+            if (!in.get(tag) || !in.get(valid) || !in.get(dirty)) return false;
+            b.tag = tag;
+            b.valid = valid;
+            b.dirty = dirty;
+        }
+        // Empty the buffer, then insert LRU first so the order comes back
+        while (head != NIL) release(head);
+        for (int i = n - 1; i >= 0; --i) insert(saved[i]);
         return true;
     }
+
       void printContent() const {
         // std::cout<<"===== VC contents =====\n";
         std::cout<<"set 0: ";
-        std::cout<<blocks.size();
-        for (const auto& block : blocks) {
-                std::cout << " " << std::setw(6) << block.tag;
-                if (block.dirty) std::cout << " D";
+        std::cout<<count;
+        for (int s = head; s != NIL; s = next[s]) {
+                std::cout << " " << std::setw(6) << blocks[s].tag;
+                if (blocks[s].dirty) std::cout << " D";
             }
         std::cout<<"\n";
-        // std::cout << "Victim Cache: " << blocks.size() << " blocks\n";
+        // std::cout << "Victim Cache: " << count << " blocks\n";
     }
 
 };
 
-class CacheSet {
+// A configuration the simulator can't run: the reason is printed and the
+// program exits, or, in a build with CACHE_SIM_THROW (libcachesim.cpp),
+// thrown as std::runtime_error so a host process can report it
+[[noreturn]] inline void simulationFailed(const std::string &reason) {
+#ifdef CACHE_SIM_THROW
+    throw std::runtime_error(reason);
+#else
+    std::cerr << reason << "\n";
+    exit(EXIT_FAILURE);
+#endif
+}
+
+// Packed per-way metadata. Every way is one 64-bit word:
+//
+//    bits 0..3          BLOCK_VALID, BLOCK_DIRTY, BLOCK_PREFETCHED, SET_IN_USE
+//    bits 4..4+S-1      replacement state, S = Policy::stateBits(assoc)
+//    bits 4+S..63       the tag's quotient by the number of sets
+//
+// The remainder of the tag is the set index, so it isn't stored. That
+// leaves room for block numbers of 64 - 4 - S + log2(numSets) bits, which
+// is every 64-bit address unless the cache has very few, very wide sets.
+enum : unsigned char {
+    BLOCK_VALID = 1,
+    BLOCK_DIRTY = 2,
+    BLOCK_PREFETCHED = 4, // filled by a prefetcher, cleared by the first demand hit
+    SET_IN_USE = 8        // way 0 only: the set has been initialized
+};
+#define WAY_FLAG_BITS 4
+#define WAY_FLAGS ((uint64_t)(BLOCK_VALID | BLOCK_DIRTY | BLOCK_PREFETCHED))
+
+// Layout of one level's way words, shared by all its set views
+struct SetGeometry {
+    int assoc;
+    int numSets;
+    int setShift;      // log2(numSets) if it is a power of two, else -1
+    int stateBits;     // replacement state bits per way
+    int tagShift;      // WAY_FLAG_BITS + stateBits
+    uint64_t maxQuotient;
+
+    SetGeometry(int assoc, int numSets, int stateBits)
+        : assoc(assoc), numSets(numSets), setShift(-1), stateBits(stateBits), tagShift(WAY_FLAG_BITS + stateBits),
+          maxQuotient(~0ULL >> (WAY_FLAG_BITS + stateBits)) {
+        if (numSets > 0 && (numSets & (numSets - 1)) == 0) setShift = bitsFor(numSets);
+    }
+
+    unsigned long quotient(unsigned long tag) const {
+        return setShift >= 0 ? tag >> setShift : tag / numSets;
+    }
+    uint64_t stateField() const { return ((1ULL << stateBits) - 1) << WAY_FLAG_BITS; }
+    // A way holds tag iff (word & matchMask()) == key(tag). A tag too wide
+    // to store gets a key no word can match: SET_IN_USE, which matchMask()
+    // clears. (Not 0, which every empty way with a zero quotient matches.)
+    uint64_t matchMask() const { return ~(WAY_FLAGS | SET_IN_USE | stateField()) | BLOCK_VALID; }
+    uint64_t key(unsigned long tag) const {
+        uint64_t q = quotient(tag);
+        return q > maxQuotient ? SET_IN_USE : (q << tagShift) | BLOCK_VALID;
+    }
+};
+
+// A tag too wide for the packed metadata can't be simulated
+[[noreturn]] inline void tagOverflow(unsigned long tag, const SetGeometry &g) {
+    std::ostringstream message;
+    message << "Block number " << tag << " does not fit the packed metadata of a cache with " << g.numSets
+            << " sets of " << g.assoc << " ways";
+    simulationFailed(message.str());
+}
+
+// A BasicCacheSet is a lightweight view over one set's slice of the
+// packed way words owned by a CacheLevel. What the state bits mean is up
+// to the replacement policy (see replacement.h); for LRU they are
+// recency ranks, so iterating by rank gives the same order the old
+// per-set linked list kept.
+template <class Policy>
+class BasicCacheSet {
 private:
-    int assoc; // Associativity
-    std::list<CacheBlock> blocks; // List for maintaining LRU order
+    SetGeometry geom; // a copy, so stores to the ways can't alias it
+    uint64_t *ways;
+    Policy *policy;
+    int index; // of the set, the part of every tag that isn't stored
+
+    WayStates states() const {
+        return WayStates(ways, WAY_FLAG_BITS, geom.stateBits);
+    }
+    unsigned long tagOf(uint64_t word) const {
+        return (unsigned long)(word >> geom.tagShift) * geom.numSets + index;
+    }
+    // Way i becomes tag with flags; its replacement state is kept for the
+    // policy's onFill
+    void fill(int i, unsigned long tag, uint64_t flags) {
+        uint64_t q = geom.quotient(tag);
+        if (q > geom.maxQuotient) tagOverflow(tag, geom);
+        ways[i] = (ways[i] & (geom.stateField() | SET_IN_USE)) | (q << geom.tagShift) | flags;
+        policy->onFill(states(), geom.assoc, i);
+    }
 
 public:
-    CacheSet(int associativity) : assoc(associativity) {
-        // Initialize cache blocks for the set
-        for (int i = 0; i < assoc; ++i) {
-            blocks.push_back(CacheBlock());
-        }
+    BasicCacheSet(const SetGeometry &geometry, uint64_t *ways, Policy *policy, int index)
+        : geom(geometry), ways(ways), policy(policy), index(index) {}
+
+    // Reset the set to assoc invalid blocks
+    void init() {
+        for (int i = 0; i < geom.assoc; ++i) ways[i] = 0;
+        policy->init(states(), geom.assoc);
+        ways[0] |= SET_IN_USE;
     }
 
-    // Check if a block with a given tag is present in the set
-    bool findBlock(unsigned long tag, CacheBlock& block) {
-        for (auto it = blocks.begin(); it != blocks.end(); ++it) {
-            if (it->valid && it->tag == tag) {
-                block = *it;
-                blocks.erase(it);
-                blocks.push_front(block); // Move to MRU
+    // Check if a block with a given tag is present in the set, and mark
+    // it dirty if markDirty. A hit is the block's first demand use if
+    // block.prefetched comes back true; block.dirty is from before the hit.
+    bool findBlock(unsigned long tag, CacheBlock& block, bool markDirty = false) {
+        uint64_t key = geom.key(tag), match = geom.matchMask();
+        for (int i = 0; i < geom.assoc; ++i) {
+            uint64_t w = ways[i];
+            if ((w & match) == key) {
+                block.tag = tag;
+                block.valid = true;
+                block.dirty = w & BLOCK_DIRTY;
+                block.prefetched = w & BLOCK_PREFETCHED;
+                uint64_t updated = (w & ~(uint64_t)BLOCK_PREFETCHED) | (markDirty ? BLOCK_DIRTY : 0);
+                if (updated != w) ways[i] = updated;
+                policy->onHit(states(), geom.assoc, i);
                 return true;
             }
         }
         return false;
     }
 
-    // Insert a block into the set (with LRU replacement)
-    CacheBlock evictAndInsert(unsigned long tag, bool dirty) {
-        CacheBlock evicted = blocks.back();
-        blocks.pop_back(); // Evict the LRU block
-        CacheBlock newBlock;
-        newBlock.tag = tag;
-        newBlock.valid = true;
-        newBlock.dirty = dirty;
-        blocks.push_front(newBlock); // Insert the new block as MRU
+    // Whether tag is in the set, without updating replacement state
+    bool contains(unsigned long tag) const {
+        uint64_t key = geom.key(tag), match = geom.matchMask();
+        for (int i = 0; i < geom.assoc; ++i) {
+            if ((ways[i] & match) == key) return true;
+        }
+        return false;
+    }
+
+    // Replace the policy's victim with a new block
+    CacheBlock evictAndInsert(unsigned long tag, bool dirty, bool prefetched = false) {
+        int way = policy->victim(states(), geom.assoc);
+        uint64_t w = ways[way];
+        CacheBlock evicted;
+        evicted.tag = tagOf(w);
+        evicted.valid = w & BLOCK_VALID;
+        evicted.dirty = w & BLOCK_DIRTY;
+        evicted.prefetched = w & BLOCK_PREFETCHED;
+        fill(way, tag, BLOCK_VALID | (dirty ? BLOCK_DIRTY : 0) | (prefetched ? BLOCK_PREFETCHED : 0));
         return evicted;
     }
 
     bool hasSpace() const {
-        for (const auto& block : blocks) {
-            if (!block.valid) return true;
+        for (int i = 0; i < geom.assoc; ++i) {
+            if (!(ways[i] & BLOCK_VALID)) return true;
         }
         return false;
     }
 
-    void insertBlock(unsigned long tag, bool dirty) {
-        for (auto it=blocks.begin();it!=blocks.end();it++) {
-            if (!(*it).valid) {
-                CacheBlock block=*it;
-                blocks.erase(it);
-                block.tag = tag;
-                block.valid = true;
-                block.dirty = dirty;
-                blocks.push_front(block); // Move to MRU
+    void insertBlock(unsigned long tag, bool dirty, bool prefetched = false) {
+        // Fill the lowest free way. Under LRU the free ways always keep
+        // their initial relative order, so this is also the most recent one.
+        for (int i = 0; i < geom.assoc; ++i) {
+            if (!(ways[i] & BLOCK_VALID)) {
+                fill(i, tag, BLOCK_VALID | (dirty ? BLOCK_DIRTY : 0) | (prefetched ? BLOCK_PREFETCHED : 0));
                 return;
             }
         }
     }
+    // Clear the way holding tag, if any; returns the block cleared
+    // (invalid if there was none)
+    CacheBlock invalidateBlock(unsigned long tag) {
+        CacheBlock cleared;
+        cleared.tag = tag;
+        uint64_t key = geom.key(tag), match = geom.matchMask();
+        for (int i = 0; i < geom.assoc; ++i) {
+            if ((ways[i] & match) == key) {
+                cleared.valid = true;
+                cleared.dirty = (ways[i] & BLOCK_DIRTY) != 0;
+                ways[i] &= ~WAY_FLAGS;
+                break;
+            }
+        }
+        return cleared;
+    }
     void displayBlocks()
     {
-    for (const auto& block : blocks) {
-                std::cout << " " << std::setw(6) <<block.tag;
-                if (block.dirty) std::cout << " D";
-            }
+    int assoc = geom.assoc;
+    WayStates state = states();
+    for (int rank = 0; rank < assoc; ++rank) {
+        for (int i = 0; i < assoc; ++i) {
+            // Print MRU to LRU when the policy keeps a recency order
+            if (Policy::recencyOrdered ? state[i] != (unsigned int)rank : i != rank) continue;
+            std::cout << " " << std::setw(6) << ((ways[i] & BLOCK_VALID) ? tagOf(ways[i]) : 0);
+            if (ways[i] & BLOCK_DIRTY) std::cout << " D";
+        }
+    }
+    }
+};
+
+// The way words of numSets sets of assoc ways, calloc'ed. A set is only
+// initialized on first use (SET_IN_USE in its way 0), so the pages of
+// sets never accessed are never backed by memory, and a huge, sparsely
+// used cache starts instantly.
+class LazyWays {
+private:
+    uint64_t* words;
+    size_t count;
+
+public:
+    LazyWays(size_t numSets, int assoc) : words(nullptr), count(numSets * assoc) {
+        words = (uint64_t*)calloc(count ? count : 1, sizeof(uint64_t));
+        if (!words) simulationFailed("Cannot allocate metadata for " + std::to_string(count) + " cache blocks");
+    }
+    LazyWays(LazyWays&& o) : words(o.words), count(o.count) { o.words = nullptr; }
+    LazyWays(const LazyWays&) = delete;
+    LazyWays& operator=(const LazyWays&) = delete;
+    ~LazyWays() { free(words); }
+
+    uint64_t* data() { return words; }
+    const uint64_t* data() const { return words; }
+};
+
+// What a CacheLevel sends its misses and writes to. Each slot type has
+// present() (whether there is a next level at all), read(address) and
+// write(address); when these are compile-time constants or direct calls,
+// the whole L1 -> L2 path inlines. The by-value slots also have
+// warm(address, write), for functional warming (see CacheLevel::warm).
+
+// End of the hierarchy: misses go to memory, which is not modelled (the
+// level counts the traffic, and may have a WriteBuffer in front of it)
+struct MainMemory {
+    static bool present() { return false; }
+    void read(unsigned long) {}
+    void write(unsigned long) {}
+    void warm(unsigned long, bool) {}
+};
+
+// A next level held by value, so the call is resolved at compile time
+template <class Level>
+struct InlineNext {
+    Level level;
+
+    explicit InlineNext(Level &&l) : level(std::move(l)) {}
+    static bool present() { return true; }
+    void read(unsigned long address) { level.handleRead(address); }
+    void write(unsigned long address) { level.handleWrite(address); }
+    void warm(unsigned long address, bool write) { level.warm(address, write); }
+};
+
+// Runtime next level: a pointer (nullptr = memory), or an EventQueue
+// feeding a level simulated on another thread (see event_queue.h)
+template <class Level>
+struct DynamicNext {
+    Level* cache;
+    EventQueue* queue;
+
+    explicit DynamicNext(Level* c) : cache(c), queue(nullptr) {}
+    bool present() const { return cache != nullptr; }
+    void read(unsigned long address) {
+        if (queue) queue->push('r', address);
+        else cache->handleRead(address);
+    }
+    void write(unsigned long address) {
+        if (queue) queue->push('w', address);
+        else cache->handleWrite(address);
     }
 };
 
+// Victim cache slots; get() is the VictimCache or nullptr
+struct NoVictimCache {
+    NoVictimCache(int = 0, int = 0) {}
+    static VictimCache* get() { return nullptr; }
+};
+
+struct InlineVictimCache {
+    VictimCache vc;
+
+    InlineVictimCache(int numBlocks, int blockSize) : vc(numBlocks, blockSize) {}
+    VictimCache* get() { return &vc; }
+    const VictimCache* get() const { return &vc; }
+};
 
-class Cache {
+// Optional, owned
+class DynamicVictimCache {
 private:
+    VictimCache* vc;
+
+public:
+    DynamicVictimCache(int numBlocks, int blockSize) : vc(numBlocks > 0 ? new VictimCache(numBlocks, blockSize) : nullptr) {}
+    DynamicVictimCache(DynamicVictimCache&& o) : vc(o.vc) { o.vc = nullptr; }
+    DynamicVictimCache(const DynamicVictimCache&) = delete;
+    DynamicVictimCache& operator=(const DynamicVictimCache&) = delete;
+    ~DynamicVictimCache() { delete vc; }
+    VictimCache* get() const { return vc; }
+};
+
+// One cache level. Next and Victim are the slot types above: the
+// runtime-configured BasicCache below uses the Dynamic ones, and
+// composed.h chains levels by value into a single type per hierarchy
+// shape so nothing on the access path goes through a pointer.
+template <class Policy, class Next, class Victim>
+class CacheLevel {
+protected:
     int size;
     int assoc;
     int blockSize;
     int numSets;
-    bool writeBack;
-    bool writeAllocate;
+    bool writeBack;     // else write-through: every write is forwarded
+    bool writeAllocate; // else a write miss bypasses the level
+
+    // Address decode for handleBatch, valid when pow2Geometry (block size
+    // and set count both powers of two)
+    bool pow2Geometry;
+    int blockShift;
+    unsigned long setMask;
+
+    // Packed way words, numSets * assoc entries indexed by set * assoc + way
+    SetGeometry geometry;
+    LazyWays ways;
+    Policy policy;
+    Next next; // Next level cache (e.g., L2) or memory
+    Victim victim; // Optional victim cache
+    MissClassifier* classifier; // If set, sees every access (see classify.h)
+    Prefetcher* prefetcher;     // If set, trained on every access (see prefetch.h)
+    int numCandidates;          // blocks the prefetcher asked for on this access
+    unsigned long candidates[PREFETCH_MAX_DEGREE];
+    WriteBuffer* writeBuffer;   // If set, coalesces writes to memory (last level only)
+
+    // Last-block filter: the tag of the last demand access while it is
+    // still the set's most recent block, else NO_LAST_TAG. Under a
+    // repeatHitIsNoop policy another access to it is a hit that changes
+    // no replacement state, so it is only counted. Off with a classifier
+    // or prefetcher, which must see every access. lastDirty is whether
+    // that block is dirty: a write-back write to it is only filtered then.
+    unsigned long lastTag;
+    bool lastDirty;
+
+    // Read the block of address from the next level or memory
+    void fetch(unsigned long address) {
+        numFetches++;
+        if (!next.present()) return;
+        PROFILE_SCOPE(PROFILE_NEXT_LEVEL);
+        PROFILE_COUNT(PROFILE_NEXT_LEVEL_REQUESTS);
+        next.read(address);
+    }
+
+    // Write the block of address to the next level or memory
+    void forwardWrite(unsigned long address) {
+        if (next.present()) {
+            PROFILE_SCOPE(PROFILE_NEXT_LEVEL);
+            PROFILE_COUNT(PROFILE_NEXT_LEVEL_REQUESTS);
+            next.write(address);
+        } else if (writeBuffer) {
+            writeBuffer->write(getTag(address));
+        }
+    }
+
+    // A write this level doesn't keep: write-through, or write-around on
+    // a no-write-allocate miss
+    void writeThrough(unsigned long address) {
+        numWriteThroughs++;
+        forwardWrite(address);
+    }
+
+    // A block leaving the level is written back if dirty
+    void writeBackBlock(const CacheBlock& leaving) {
+        if (leaving.valid && leaving.dirty) {
+            numWritebacks++;
+            forwardWrite(leaving.tag * blockSize);
+        }
+    }
 
-    std::vector<CacheSet> sets;
-    Cache* nextLevelCache; // Pointer to the next level cache (e.g., L2 or memory)
-    VictimCache* victimCache; // Optional victim cache
+    // A block leaving the sets goes to the VC, if any, and whatever
+    // leaves the level is written back if dirty
+    void retire(CacheBlock evicted) {
+        if (!evicted.valid) return;
+        if (VictimCache* vc = victim.get()) evicted = vc->insert(evicted);
+        writeBackBlock(evicted);
+    }
+
+    bool takeFromVictimCache(unsigned long tag, CacheBlock& block) {
+        PROFILE_SCOPE(PROFILE_VC_SEARCH);
+        bool found = victim.get()->take(tag, block);
+        if (found) PROFILE_COUNT(PROFILE_VC_HITS);
+        return found;
+    }
+
+#ifdef CACHE_SIM_PROFILE
+    ProfileSets* profileSets; // per-set access/eviction histograms
+#endif
 
 public:
-    int numReads;
-    int numReadMisses;
-    int numWrites;
-    int numWriteMisses;
-    int numSwaps;
-    int numSwapsFromVC;
-    int numWritebacks;
-    Cache(int cacheSize, int associativity, int blockSize, Cache* nextLevel = nullptr, int victimCacheSize = 0) 
-        : size(cacheSize), assoc(associativity), blockSize(blockSize), nextLevelCache(nextLevel), victimCache(victimCacheSize > 0 ? new VictimCache(victimCacheSize, blockSize) : nullptr),
-         numReads(0), numReadMisses(0), numWrites(0), numWriteMisses(0), numSwaps(0), numSwapsFromVC(0), numWritebacks(0) {
-        
-        numSets = size / (blockSize * assoc);
-        sets.resize(numSets, CacheSet(assoc));
-       
-    }
-  ~Cache() {
-        delete victimCache;
+    typedef Next NextType;
+    typedef Victim VictimType;
+
+    long numReads;
+    long numReadMisses;
+    long numWrites;
+    long numWriteMisses;
+    long numSwapRequests; // misses with a full set and a VC to search
+    long numSwaps;        // of those, VC hits swapped into the set
+    long numSwapsFromVC;
+    long numWritebacks;   // dirty blocks leaving the level (from the VC if there is one)
+    long numFetches;      // blocks read from the next level, prefetches included
+    long numWriteThroughs; // writes forwarded without a block: write-through and write-around
+    CacheLevel(int cacheSize, int associativity, int blockSize, Next nextLevel, Victim victimCache)
+        : size(cacheSize), assoc(associativity), blockSize(blockSize), numSets(size / (blockSize * assoc)),
+          writeBack(true), writeAllocate(true),
+          geometry(assoc, numSets, Policy::stateBits(assoc)), ways(numSets, assoc), next(std::move(nextLevel)), victim(std::move(victimCache)),
+         classifier(nullptr), prefetcher(nullptr), numCandidates(0), candidates(), writeBuffer(nullptr), lastTag(NO_LAST_TAG), lastDirty(false), numReads(0), numReadMisses(0), numWrites(0), numWriteMisses(0),
+         numSwapRequests(0), numSwaps(0), numSwapsFromVC(0), numWritebacks(0), numFetches(0), numWriteThroughs(0) {
+
+        pow2Geometry = blockSize > 0 && numSets > 0 && (blockSize & (blockSize - 1)) == 0 && (numSets & (numSets - 1)) == 0;
+        blockShift = 0;
+        while (pow2Geometry && (1 << blockShift) < blockSize) blockShift++;
+        setMask = (unsigned long)numSets - 1;
+#ifdef CACHE_SIM_PROFILE
+        profileSets = profileRegistry().addCache(size, assoc, blockSize, numSets);
+#endif
+
+    }
+
+    // A view of set index, initialized on first use
+    BasicCacheSet<Policy> set(int index) {
+        uint64_t* w = ways.data() + (size_t)index * assoc;
+        BasicCacheSet<Policy> s(geometry, w, &policy, index);
+        if (__builtin_expect(!(w[0] & SET_IN_USE), 0)) s.init();
+        return s;
+    }
+
+    bool setInUse(int index) const { return ways.data()[(size_t)index * assoc] & SET_IN_USE; }
+
+    int getNumSets() const { return numSets; }
+
+    Next& nextLevel() { return next; }
+
+    // Everything that determines future behaviour, plus the counters; the
+    // next level saves itself (see checkpoint.h). Only sets that have been
+    // used are written.
+    void saveState(CheckpointWriter& out) const {
+        static_assert(std::is_trivially_copyable<Policy>::value, "policy state is saved as raw bytes");
+        out.put((int32_t)numSets);
+        out.put((int32_t)assoc);
+        out.put((int32_t)blockSize);
+        std::vector<uint64_t> inUse(((size_t)numSets + 63) / 64, 0);
+        for (int i = 0; i < numSets; ++i) {
+            if (setInUse(i)) inUse[i >> 6] |= 1ULL << (i & 63);
+        }
+        out.putArray(inUse);
+        for (int i = 0; i < numSets; ++i) {
+            if ((inUse[i >> 6] >> (i & 63)) & 1) out.put(ways.data() + (size_t)i * assoc, assoc * sizeof(uint64_t));
+        }
+        out.put(policy);
+        const int64_t counters[10] = {numReads, numReadMisses, numWrites, numWriteMisses, numSwapRequests,
+                                      numSwaps, numSwapsFromVC, numWritebacks, numFetches, numWriteThroughs};
+        out.put(counters);
+        if (const VictimCache* vc = victim.get()) vc->saveState(out);
+        else out.put((int32_t)0);
+    }
+    bool loadState(CheckpointReader& in) {
+        int32_t saved[3];
+        if (!in.get(saved) || saved[0] != numSets || saved[1] != assoc || saved[2] != blockSize) return false;
+        std::vector<uint64_t> inUse(((size_t)numSets + 63) / 64);
+        if (!in.getArray(inUse)) return false;
+        for (int i = 0; i < numSets; ++i) {
+            if ((inUse[i >> 6] >> (i & 63)) & 1) {
+                if (!in.get(ways.data() + (size_t)i * assoc, assoc * sizeof(uint64_t))) return false;
+            } else {
+                for (int w = 0; w < assoc; ++w) ways.data()[(size_t)i * assoc + w] = 0;
+            }
+        }
+        int64_t counters[10];
+        if (!in.get(policy) || !in.get(counters)) return false;
+        numReads = counters[0];
+        numReadMisses = counters[1];
+        numWrites = counters[2];
+        numWriteMisses = counters[3];
+        numSwapRequests = counters[4];
+        numSwaps = counters[5];
+        numSwapsFromVC = counters[6];
+        numWritebacks = counters[7];
+        numFetches = counters[8];
+        numWriteThroughs = counters[9];
+        lastTag = NO_LAST_TAG;
+        if (VictimCache* vc = victim.get()) return vc->loadState(in);
+        int32_t none;
+        return in.get(none) && none == 0;
+    }
+
+    // Attribute every miss to compulsory/capacity/conflict (nullptr to stop)
+    void setClassifier(MissClassifier* c) { classifier = c; }
+    // Prefetch into this level (nullptr to stop)
+    void setPrefetcher(Prefetcher* p) { prefetcher = p; }
+    // Write-back or write-through, write-allocate or not (default both)
+    void setWritePolicy(bool back, bool allocate) {
+        writeBack = back;
+        writeAllocate = allocate;
+        lastTag = NO_LAST_TAG;
+    }
+    bool isWriteBack() const { return writeBack; }
+    bool isWriteAllocate() const { return writeAllocate; }
+    // Coalesce this level's writes to memory (nullptr to stop); only
+    // meaningful on the last level
+    void setWriteBuffer(WriteBuffer* b) { writeBuffer = b; }
+    long coalescedWrites() const { return writeBuffer ? writeBuffer->stats.coalesced : 0; }
+    int getNumBlocks() const { return numSets * assoc; }
+
+    // Copy set `from` of src (same associativity and policy) into set `to`
+    // of this cache, passing the tags of valid blocks through mapTag. Used
+    // to merge set-sharded runs.
+    template <class F>
+    void importSet(const CacheLevel &src, int from, int to, F mapTag) {
+        lastTag = NO_LAST_TAG;
+        const uint64_t* s = src.ways.data() + (size_t)from * assoc;
+        uint64_t* d = ways.data() + (size_t)to * assoc;
+        uint64_t low = WAY_FLAGS | SET_IN_USE | geometry.stateField();
+        for (int w = 0; w < assoc; ++w) {
+            d[w] = s[w];
+            if (!(s[w] & BLOCK_VALID)) continue;
+            unsigned long tag = mapTag((unsigned long)(s[w] >> geometry.tagShift) * src.numSets + from);
+            d[w] = (s[w] & low) | ((uint64_t)geometry.quotient(tag) << geometry.tagShift);
+        }
     }
 
     unsigned long getTag(unsigned long address) const {
@@ -185,89 +725,293 @@ public:
     }
 
     void handleRead(unsigned long address) {
+        unsigned long tag;
+        int index;
+        {
+            PROFILE_SCOPE(PROFILE_DECODE);
+            tag = getTag(address);
+            index = getIndex(address);
+        }
+        readDecoded(address, tag, index);
+    }
+
+    void handleWrite(unsigned long address) {
+        unsigned long tag;
+        int index;
+        {
+            PROFILE_SCOPE(PROFILE_DECODE);
+            tag = getTag(address);
+            index = getIndex(address);
+        }
+        writeDecoded(address, tag, index);
+    }
+
+    // Functional warming (see sampling.h): the state an access leaves
+    // behind, tags, replacement state, dirty bits, the VC and the next
+    // level's own warming, without any counter, prefetcher, classifier
+    // or write buffer seeing it
+    void warm(unsigned long address, bool write) {
+        lastTag = NO_LAST_TAG;
+        unsigned long tag = getTag(address);
+        BasicCacheSet<Policy> s = set(getIndex(address));
+        bool dirties = write && writeBack;
+        bool forward = write && !writeBack; // write-through, or write-around below
+        CacheBlock block;
+        VictimCache* victimCache = victim.get();
+        bool full;
+        if (s.findBlock(tag, block, dirties)) {
+            // hit
+        } else if ((full = !s.hasSpace()) && victimCache && victimCache->take(tag, block)) {
+            victimCache->insert(s.evictAndInsert(tag, block.dirty || dirties));
+        } else if (write && !writeAllocate) {
+            forward = true;
+        } else {
+            CacheBlock evicted;
+            if (full) evicted = s.evictAndInsert(tag, dirties);
+            else s.insertBlock(tag, dirties);
+            if (evicted.valid && victimCache) evicted = victimCache->insert(evicted);
+            if (evicted.valid && evicted.dirty) next.warm(evicted.tag * blockSize, true);
+            next.warm(address, false);
+        }
+        if (forward) next.warm(address, true);
+    }
+
+    // Remove the block holding address from the sets and the VC, as a
+    // coherence invalidation from another core (see multicore.h), writing
+    // it back first if dirty; returns true if it was cached
+    bool invalidate(unsigned long address) {
+        unsigned long tag = getTag(address);
+        lastTag = NO_LAST_TAG;
+        CacheBlock cleared = set(getIndex(address)).invalidateBlock(tag);
+        if (VictimCache* vc = victim.get()) {
+            CacheBlock dropped = vc->invalidate(tag);
+            cleared.valid = cleared.valid || dropped.valid;
+            cleared.dirty = cleared.dirty || dropped.dirty;
+        }
+        writeBackBlock(cleared);
+        return cleared.valid;
+    }
+
+    // Accesses records[0..n) in order, with the same effect as calling
+    // handleRead/handleWrite on each. With a power-of-two geometry the
+    // tags and indices of a whole chunk are decoded up front with a shift
+    // and a mask, and each set's metadata is prefetched a few accesses
+    // before it is looked up.
+    void handleBatch(const Access* records, size_t n) {
+        accessBatch(n, [records](size_t i) { return records[i].address; },
+                    [records](size_t i) { return records[i].type != 'r'; });
+    }
+
+    // The same over parallel arrays, read in place: access i is to
+    // addresses[i], a write iff ops[i] is non-zero (all reads if ops is
+    // nullptr). Used by the library interface (see libcachesim.h).
+    void handleBatch(const uint64_t* addresses, const uint8_t* ops, size_t n) {
+        if (ops) accessBatch(n, [addresses](size_t i) { return (unsigned long)addresses[i]; },
+                             [ops](size_t i) { return ops[i] != 0; });
+        else accessBatch(n, [addresses](size_t i) { return (unsigned long)addresses[i]; },
+                         [](size_t) { return false; });
+    }
+
+    // A run of repeat (at most 32) accesses to the block of address,
+    // access i a write iff bit i of ops is set, with the same effect as
+    // handleRead/handleWrite on each (see the compacted traces of
+    // trace.h). Once the block is the last one, and dirty or only read
+    // from here on, the rest are just counted. Write-through writes are
+    // each forwarded, so those runs go access by access.
+    void handleRun(unsigned long address, uint32_t ops, int repeat) {
         unsigned long tag = getTag(address);
         int index = getIndex(address);
+        for (int i = 0; i < repeat; ++i) {
+            if (Policy::repeatHitIsNoop && tag == lastTag) {
+                uint32_t rest = (repeat - i < 32 ? (1U << (repeat - i)) - 1 : ~0U) & (ops >> i);
+                int writes = __builtin_popcount(rest);
+                if (writeBack && (lastDirty || writes == 0)) {
+                    repeatHits(repeat - i - writes, writes);
+                    return;
+                }
+            }
+            if ((ops >> i) & 1) writeDecoded(address, tag, index);
+            else readDecoded(address, tag, index);
+        }
+    }
 
-        numReads++;
-        CacheBlock block;
-        if (sets[index].findBlock(tag, block)) {
-            // Cache hit, update LRU
-            //Latest block moved to front inside the function
+private:
+    // The batch loop of handleBatch, over access i at address(i), a
+    // write iff isWrite(i)
+    template <class Address, class IsWrite>
+    void accessBatch(size_t n, Address address, IsWrite isWrite) {
+        if (!pow2Geometry) {
+            for (size_t i = 0; i < n; ++i) {
+                if (isWrite(i)) handleWrite(address(i));
+                else handleRead(address(i));
+            }
             return;
         }
-        numReadMisses++;
-        // Cache miss, handle VC if present
-        if (victimCache && !sets[index].hasSpace()) {
-            // Search VC for the block
-            if (victimCache->findBlock(tag)) {
-                numSwaps++;
-                // Swap block from VC to L1
-                numSwapsFromVC++;
-                victimCache->swapBlock(tag, sets[index].evictAndInsert(tag, false));
-                return;
+        unsigned long batchTags[CACHE_BATCH];
+        int batchIndex[CACHE_BATCH];
+        for (size_t begin = 0; begin < n; begin += CACHE_BATCH) {
+            size_t count = n - begin < CACHE_BATCH ? n - begin : CACHE_BATCH;
+            {
+                PROFILE_SCOPE(PROFILE_DECODE);
+                for (size_t i = 0; i < count; ++i) {
+                    batchTags[i] = address(begin + i) >> blockShift;
+                    batchIndex[i] = (int)(batchTags[i] & setMask);
+                }
+            }
+            for (size_t i = 0; i < count && i < CACHE_PREFETCH_DISTANCE; ++i) prefetchSet(batchIndex[i]);
+            for (size_t i = 0; i < count; ++i) {
+                if (i + CACHE_PREFETCH_DISTANCE < count) prefetchSet(batchIndex[i + CACHE_PREFETCH_DISTANCE]);
+                if (isWrite(begin + i)) writeDecoded(address(begin + i), batchTags[i], batchIndex[i]);
+                else readDecoded(address(begin + i), batchTags[i], batchIndex[i]);
             }
+        }
+    }
+
+    // reads + writes more accesses to the last block (see lastTag)
+    void repeatHits(int reads, int writes) {
+        PROFILE_COUNT_N(PROFILE_READS, reads);
+        PROFILE_COUNT_N(PROFILE_WRITES, writes);
+        PROFILE_COUNT_N(PROFILE_REPEAT_HITS, reads + writes);
+        numReads += reads;
+        numWrites += writes;
+    }
+
+    void prefetchSet(int index) const {
+        __builtin_prefetch(ways.data() + (size_t)index * assoc);
+    }
 
+    void readDecoded(unsigned long address, unsigned long tag, int index) {
+        if (Policy::repeatHitIsNoop) {
+            if (tag == lastTag) {
+                repeatHits(1, 0);
+                return;
+            }
+            lastTag = classifier || prefetcher ? NO_LAST_TAG : tag;
         }
+        demand(address, tag, index, false);
+        if (numCandidates) issuePrefetches();
+    }
 
-        // Miss in both cache and VC
-        if (nextLevelCache) {
-            nextLevelCache->handleRead(address);
-            numReadMisses++;
+    void writeDecoded(unsigned long address, unsigned long tag, int index) {
+        if (Policy::repeatHitIsNoop) {
+            if (tag == lastTag && (lastDirty || !writeBack)) {
+                repeatHits(0, 1);
+                if (!writeBack) writeThrough(address);
+                return;
+            }
+            lastTag = classifier || prefetcher ? NO_LAST_TAG : tag;
         }
+        demand(address, tag, index, true);
+        if (numCandidates) issuePrefetches();
+    }
 
-        if (sets[index].hasSpace()) {
-            
-            sets[index].insertBlock(tag, false);
-        } else {
-            CacheBlock evicted = sets[index].evictAndInsert(tag, false);
-            
-            if (victimCache) {
-                victimCache->insert(evicted);
+    // Fetch the prefetcher's candidates that are not cached yet from the
+    // next level and fill them as BLOCK_PREFETCHED, after the demand
+    // access that triggered them. A prefetch is only a hint, so a
+    // candidate past the address space or too wide for the packed
+    // metadata is dropped rather than failing the run in fill().
+    void issuePrefetches() {
+        int n = numCandidates;
+        numCandidates = 0;
+        VictimCache* victimCache = victim.get();
+        for (int k = 0; k < n; ++k) {
+            if (candidates[k] > ~0UL / blockSize) continue;
+            unsigned long address = candidates[k] * blockSize;
+            unsigned long tag = getTag(address);
+            if (geometry.quotient(tag) > geometry.maxQuotient) continue;
+            BasicCacheSet<Policy> s = set(getIndex(address));
+            if (s.contains(tag) || (victimCache && victimCache->contains(tag))) continue;
+            CacheBlock evicted;
+            if (s.hasSpace()) {
+                s.insertBlock(tag, false, true);
+            } else {
+                evicted = s.evictAndInsert(tag, false, true);
+                retire(evicted);
             }
+            fetch(address);
+            prefetcher->filled(tag, numReads + numWrites, evicted.valid, evicted.tag);
         }
     }
 
-    void handleWrite(unsigned long address) {
-        unsigned long tag = getTag(address);
-        int index = getIndex(address);
+    // One demand access. A miss searches the VC when the set is full
+    // and swaps a block found there into the set (the set's victim takes
+    // its place in the VC). Otherwise the victim is retired before the
+    // block is fetched, so its writeback reaches the next level first. A
+    // write hit or allocating write miss dirties the block under
+    // write-back and is forwarded under write-through; a write miss
+    // without write-allocate only goes around the level.
+    void demand(unsigned long address, unsigned long tag, int index, bool write) {
+        BasicCacheSet<Policy> s = set(index);
+        if (write) {
+            PROFILE_COUNT(PROFILE_WRITES);
+            numWrites++;
+        } else {
+            PROFILE_COUNT(PROFILE_READS);
+            numReads++;
+        }
+        PROFILE_SET_ACCESS(index);
 
-        numWrites++;
+        bool dirties = write && writeBack;
         CacheBlock block;
-        if (sets[index].findBlock(tag, block)) {
-            // Cache hit, mark dirty if write-back policy
-            block.dirty = true;
+        bool hit;
+        {
+            PROFILE_SCOPE(PROFILE_SET_LOOKUP);
+            hit = s.findBlock(tag, block, dirties);
+        }
+        if (classifier) classifier->access(tag, write, hit, block.prefetched);
+        if (prefetcher) numCandidates = prefetcher->demand(tag, hit, block.prefetched, numReads + numWrites, candidates);
+        if (hit) {
+            PROFILE_COUNT(PROFILE_SET_HITS);
+            lastDirty = block.dirty || dirties;
+            if (write && !writeBack) writeThrough(address);
             return;
         }
-        numWriteMisses++;
-        // Cache miss, handle VC
-        if (victimCache && !sets[index].hasSpace()) {
-            if (victimCache->findBlock(tag)) {
+        PROFILE_COUNT(PROFILE_SET_MISSES);
+        if (write) numWriteMisses++;
+        else numReadMisses++;
+
+        VictimCache* victimCache = victim.get();
+        bool full = !s.hasSpace();
+        if (victimCache && full) {
+            numSwapRequests++;
+            CacheBlock swapped;
+            if (takeFromVictimCache(tag, swapped)) {
                 numSwaps++;
                 numSwapsFromVC++;
-                victimCache->swapBlock(tag, sets[index].evictAndInsert(tag, true));
+                PROFILE_SCOPE(PROFILE_EVICTION);
+                PROFILE_SET_EVICTION(index);
+                lastDirty = swapped.dirty || dirties;
+                victimCache->insert(s.evictAndInsert(tag, lastDirty)); // into the slot take() freed
+                if (write && !writeBack) writeThrough(address);
                 return;
             }
         }
 
-        // Miss in both cache and VC
-        if (nextLevelCache) {
-            
-            nextLevelCache->handleRead(address);
+        if (write && !writeAllocate) {
+            lastTag = NO_LAST_TAG; // not cached
+            writeThrough(address);
+            return;
         }
-
-        if (sets[index].hasSpace()) {
-            sets[index].insertBlock(tag, true);
-        } else {
-            CacheBlock evicted = sets[index].evictAndInsert(tag, true);
-            if (victimCache) {
-                victimCache->insert(evicted);
+        lastDirty = dirties;
+        CacheBlock evicted;
+        {
+            PROFILE_SCOPE(PROFILE_EVICTION);
+            if (full) {
+                PROFILE_SET_EVICTION(index);
+                evicted = s.evictAndInsert(tag, dirties);
+            } else {
+                s.insertBlock(tag, dirties);
             }
         }
+        retire(evicted);
+        fetch(address);
+        if (write && !writeBack) writeThrough(address);
     }
+public:
     void printContents() {
         for (int i = 0; i < numSets; ++i) {
             std::cout << "  set " << i << ":";
-            sets[i].displayBlocks();
+            set(i).displayBlocks();
             std::cout << "\n";
         }
     }
@@ -278,8 +1022,8 @@ public:
         std::cout << "L1 read misses: " << numReadMisses << "\n";
         std::cout << "L1 writes: " << numWrites << "\n";
         std::cout << "L1 write misses: " << numWriteMisses << "\n";
-        std::cout << "Swap requests from L1 to VC: " << numSwaps << "\n";
-        std::cout << "Swap request rate: " << (numReads + numWrites > 0 ? static_cast<double>(numSwaps) / (numReads + numWrites) : 0) << "\n";
+        std::cout << "Swap requests from L1 to VC: " << numSwapRequests << "\n";
+        std::cout << "Swap request rate: " << (numReads + numWrites > 0 ? static_cast<double>(numSwapRequests) / (numReads + numWrites) : 0) << "\n";
         std::cout << "Swaps between L1 and VC: " << numSwaps << "\n";
         std::cout << "Combined L1+VC miss rate: " << (numReads + numWrites > 0 ? static_cast<double>(numReadMisses + numWriteMisses - numSwaps) / (numReads + numWrites) : 0) << "\n";
         std::cout << "Writebacks from L1 or VC to next level: " << numWritebacks << "\n";
@@ -287,10 +1031,27 @@ public:
     }
     void printVictimContents() const {
         // std::cout << "Victim Cache Statistics:\n";
-        victimCache->printContent();
+        if (const VictimCache* vc = victim.get()) vc->printContent();
     }
 };
 
+// A cache level configured at run time: the next level is a pointer (or
+// an event queue) and the victim cache is optional
+template <class Policy>
+class BasicCache : public CacheLevel<Policy, DynamicNext<BasicCache<Policy> >, DynamicVictimCache> {
+public:
+    BasicCache(int cacheSize, int associativity, int blockSize, BasicCache* nextLevel = nullptr, int victimCacheSize = 0)
+        : CacheLevel<Policy, DynamicNext<BasicCache<Policy> >, DynamicVictimCache>(
+              cacheSize, associativity, blockSize, DynamicNext<BasicCache>(nextLevel),
+              DynamicVictimCache(victimCacheSize, blockSize)) {}
+
+    // Send next level requests through queue (nullptr to call it directly)
+    void setNextLevelQueue(EventQueue* queue) { this->next.queue = queue; }
+};
+
+typedef BasicCacheSet<LRUPolicy> CacheSet;
+typedef BasicCache<LRUPolicy> Cache;
+
 
 
 // int main() {
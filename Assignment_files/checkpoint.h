@@ -0,0 +1,252 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+///////////////////////////////////////////////////////////////////////////
+// Warm-state checkpoints (cache_sim --save-state / --restore-state)
+//
+//    A checkpoint is the complete state of a hierarchy after some prefix
+//    of a trace: every level's packed tags, flags and replacement state, the
+//    replacement policy object itself, the counters and the VC in
+//    recency order, plus the number of trace accesses consumed. A run
+//    restored from it and continued over the rest of the trace ends in
+//    exactly the state of one uninterrupted run. The trace is identified
+//    by its size and a hash of its first and last MB (traceIdentity), so
+//    restoring against a different or regenerated trace is refused
+//    rather than resumed at a meaningless position.
+//
+//    File layout (native byte order, it is not meant to travel between
+//    machines):
+//
+//       CheckpointHeader (configuration, policy name, trace identity and position)
+//       L1 level, then L2 level if there is one, each:
+//          int32 numSets, assoc, blockSize
+//          uint64 bitmap of the sets in use[(numSets + 63) / 64]
+//          uint64 packed way words[assoc] of every set in use, in set order
+//          replacement policy object (raw bytes)
+//          int64 counters[10]
+//          int32 VC entries, then per entry uint64 tag, uint8 valid, uint8 dirty
+//
+//    Restoring maps the file and copies the arrays straight out of the
+//    mapping.
+///////////////////////////////////////////////////////////////////////////
+
+#define CHECKPOINT_MAGIC "CSCK"
+#define CHECKPOINT_VERSION 5
+#define CHECKPOINT_TRACE_SAMPLE (1 << 20) // bytes hashed at each end of the trace
+
+struct CheckpointHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t config[6];  // L1_SIZE L1_ASSOC L1_BLOCKSIZE VC_NUM_BLOCKS L2_SIZE L2_ASSOC
+    char policy[16];    // replacement policy name
+    uint64_t traceSize; // bytes of the trace file
+    uint64_t traceHash; // see traceIdentity
+    uint64_t position;  // trace accesses simulated
+    uint64_t length;    // bytes of level state following the header
+};
+
+// Appends state to an in-memory buffer, written out in one go
+class CheckpointWriter {
+private:
+    std::vector<char> buffer;
+
+public:
+    void put(const void *data, size_t n) {
+        const char *p = (const char *)data;
+        buffer.insert(buffer.end(), p, p + n);
+    }
+    template <class T>
+    void put(const T &value) { put(&value, sizeof(T)); }
+    template <class T>
+    void putArray(const std::vector<T> &v) { put(v.data(), v.size() * sizeof(T)); }
+
+    size_t size() const { return buffer.size(); }
+    const char *data() const { return buffer.data(); }
+};
+
+// Reads state back out of a mapped checkpoint; every get fails once the
+// data runs out
+class CheckpointReader {
+private:
+    const char *p;
+    const char *end;
+
+public:
+    CheckpointReader(const char *begin, const char *end) : p(begin), end(end) {}
+
+    bool get(void *data, size_t n) {
+        if ((size_t)(end - p) < n) {
+            p = end;
+            return false;
+        }
+        memcpy(data, p, n);
+        p += n;
+        return true;
+    }
+    template <class T>
+    bool get(T &value) { return get(&value, sizeof(T)); }
+    template <class T>
+    bool getArray(std::vector<T> &v) { return get(v.data(), v.size() * sizeof(T)); }
+
+    bool atEnd() const { return p == end; }
+};
+
+// Read-only mapping of a whole file
+class MappedFile {
+private:
+    void *base;
+    size_t length;
+
+public:
+    MappedFile() : base(nullptr), length(0) {}
+    ~MappedFile() { close(); }
+
+    bool open(const char *path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        length = st.st_size;
+        base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            base = nullptr;
+            return false;
+        }
+        return true;
+    }
+    void close() {
+        if (base) munmap(base, length);
+        base = nullptr;
+        length = 0;
+    }
+
+    const char *data() const { return (const char *)base; }
+    size_t size() const { return length; }
+};
+
+// Size of the trace file at path and an FNV-1a hash of its first and
+// last CHECKPOINT_TRACE_SAMPLE bytes: cheap at any trace length, and
+// different for another or a regenerated trace. False if it can't be read.
+inline bool traceIdentity(const std::string &path, uint64_t &size, uint64_t &hash) {
+    FILE *in = fopen(path.c_str(), "rb");
+    if (!in) return false;
+    struct stat st;
+    if (fstat(fileno(in), &st) != 0) {
+        fclose(in);
+        return false;
+    }
+    size = st.st_size;
+    hash = 0xcbf29ce484222325ULL;
+    std::vector<unsigned char> buffer(CHECKPOINT_TRACE_SAMPLE);
+    uint64_t tail = size > CHECKPOINT_TRACE_SAMPLE ? size - CHECKPOINT_TRACE_SAMPLE : 0;
+    bool ok = true;
+    for (uint64_t offset : {(uint64_t)0, tail}) {
+        size_t n = fseeko(in, offset, SEEK_SET) == 0 ? fread(buffer.data(), 1, buffer.size(), in) : 0;
+        ok = ok && n == std::min<uint64_t>(buffer.size(), size - offset);
+        for (size_t i = 0; i < n; ++i) hash = (hash ^ buffer[i]) * 0x100000001b3ULL;
+    }
+    fclose(in);
+    return ok;
+}
+
+inline void checkpointConfig(const int config[6], const char *policy, CheckpointHeader &h) {
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CHECKPOINT_MAGIC, 4);
+    h.version = CHECKPOINT_VERSION;
+    for (int i = 0; i < 6; ++i) h.config[i] = config[i];
+    strncpy(h.policy, policy, sizeof(h.policy) - 1);
+}
+
+// Write the state of hierarchy h (BasicHierarchy or ComposedHierarchy)
+// after `position` accesses of trace. Returns false with a reason in error.
+template <class H>
+bool saveCheckpoint(const std::string &path, const H &h, const char *policy, const std::string &trace,
+                    uint64_t position, std::string &error) {
+    const int config[6] = {h.config.L1_SIZE, h.config.L1_ASSOC, h.config.L1_BLOCKSIZE,
+                           h.config.VC_NUM_BLOCKS, h.config.L2_SIZE, h.config.L2_ASSOC};
+    CheckpointWriter state;
+    h.l1Cache->saveState(state);
+    if (h.l2Cache) h.l2Cache->saveState(state);
+
+    CheckpointHeader header;
+    checkpointConfig(config, policy, header);
+    if (!traceIdentity(trace, header.traceSize, header.traceHash)) {
+        error = "Cannot read trace file " + trace;
+        return false;
+    }
+    header.position = position;
+    header.length = state.size();
+
+    FILE *out = fopen(path.c_str(), "wb");
+    if (!out) {
+        error = "Cannot write checkpoint " + path;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 && fwrite(state.data(), 1, state.size(), out) == state.size();
+    ok = fclose(out) == 0 && ok;
+    if (!ok) error = "Error writing checkpoint " + path;
+    return ok;
+}
+
+// Restore h from a checkpoint written for the same configuration, policy
+// and trace; position is set to the number of trace accesses it covers
+template <class H>
+bool loadCheckpoint(const std::string &path, H &h, const char *policy, const std::string &trace,
+                    uint64_t &position, std::string &error) {
+    MappedFile file;
+    if (!file.open(path.c_str()) || file.size() < sizeof(CheckpointHeader)) {
+        error = "Cannot read checkpoint " + path;
+        return false;
+    }
+    CheckpointHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, CHECKPOINT_MAGIC, 4) != 0 || header.version != CHECKPOINT_VERSION ||
+        header.length != file.size() - sizeof(header)) {
+        error = path + " is not a checkpoint";
+        return false;
+    }
+    const int config[6] = {h.config.L1_SIZE, h.config.L1_ASSOC, h.config.L1_BLOCKSIZE,
+                           h.config.VC_NUM_BLOCKS, h.config.L2_SIZE, h.config.L2_ASSOC};
+    CheckpointHeader expected;
+    checkpointConfig(config, policy, expected);
+    if (memcmp(header.config, expected.config, sizeof(header.config)) != 0 ||
+        strncmp(header.policy, expected.policy, sizeof(header.policy)) != 0) {
+        error = "Checkpoint " + path + " was saved for a different configuration or replacement policy";
+        return false;
+    }
+    uint64_t traceSize, traceHash;
+    if (!traceIdentity(trace, traceSize, traceHash)) {
+        error = "Cannot read trace file " + trace;
+        return false;
+    }
+    if (traceSize != header.traceSize || traceHash != header.traceHash) {
+        error = "Checkpoint " + path + " was saved for a different trace than " + trace;
+        return false;
+    }
+
+    CheckpointReader state(file.data() + sizeof(header), file.data() + file.size());
+    bool ok = h.l1Cache->loadState(state) && (!h.l2Cache || h.l2Cache->loadState(state)) && state.atEnd();
+    if (!ok) {
+        error = "Checkpoint " + path + " is truncated or corrupt";
+        return false;
+    }
+    position = header.position;
+    return true;
+}
+
+#endif
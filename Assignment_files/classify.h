@@ -0,0 +1,111 @@
+#ifndef CLASSIFY_H
+#define CLASSIFY_H
+
+#include <vector>
+#include <unordered_set>
+#include "tag_index.h"
+
+///////////////////////////////////////////////////////////////////////////
+// Three-C miss classification (cache_sim --classify)
+//
+//    Every miss of a cache's sets is attributed to one of
+//
+//       compulsory  first access to the block
+//       capacity    also misses in a fully associative LRU cache with
+//                   the same number of blocks
+//       conflict    would have hit in that fully associative cache
+//
+//    The fully associative cache is a ShadowCache that sees every access
+//    of the real one. A cache with a VC still counts a VC hit as a miss
+//    of its sets, so the VC's benefit shows up as fewer conflict (and
+//    capacity) misses being left for the next level, not here.
+///////////////////////////////////////////////////////////////////////////
+
+// Fully associative LRU tag store with O(1) access: a preallocated slot
+// array on an intrusive recency list, found through a TagIndex
+class ShadowCache {
+private:
+    int numBlocks;
+    std::vector<unsigned long> tags;
+    std::vector<int> prev, next; // recency list links, -1 terminated
+    int head, tail;              // MRU and LRU slots
+    int count;
+    TagIndex index;
+
+    void unlink(int slot) {
+        if (prev[slot] >= 0) next[prev[slot]] = next[slot];
+        else head = next[slot];
+        if (next[slot] >= 0) prev[next[slot]] = prev[slot];
+        else tail = prev[slot];
+    }
+    void pushFront(int slot) {
+        prev[slot] = -1;
+        next[slot] = head;
+        if (head >= 0) prev[head] = slot;
+        else tail = slot;
+        head = slot;
+    }
+
+public:
+    explicit ShadowCache(int nblocks)
+        : numBlocks(nblocks), tags(nblocks), prev(nblocks, -1), next(nblocks, -1),
+          head(-1), tail(-1), count(0), index(nblocks) {}
+
+    // Access block, making it MRU; returns true on a hit
+    bool access(unsigned long block) {
+        int slot = index.find(block);
+        if (slot >= 0) {
+            if (slot != head) {
+                unlink(slot);
+                pushFront(slot);
+            }
+            return true;
+        }
+        if (count < numBlocks) {
+            slot = count++;
+        } else {
+            slot = tail; // replace LRU
+            index.erase(tags[slot]);
+            unlink(slot);
+        }
+        tags[slot] = block;
+        index.set(block, slot);
+        pushFront(slot);
+        return false;
+    }
+};
+
+// Per-cache 3C counters plus the state needed to compute them
+class MissClassifier {
+private:
+    ShadowCache shadow;
+    std::unordered_set<unsigned long> seen; // blocks demanded at least once
+
+public:
+    // [0] reads, [1] writes
+    long compulsory[2];
+    long capacity[2];
+    long conflict[2];
+
+    explicit MissClassifier(int numBlocks) : shadow(numBlocks), compulsory{0, 0}, capacity{0, 0}, conflict{0, 0} {}
+
+    // Called for every access of the cache with its outcome. A block's
+    // first access is a miss unless a prefetcher brought it in, so only
+    // misses and first hits on prefetched blocks need the seen set.
+    void access(unsigned long block, bool isWrite, bool hit, bool prefetched = false) {
+        bool shadowHit = shadow.access(block);
+        if (hit) {
+            if (prefetched) seen.insert(block);
+            return;
+        }
+        if (seen.insert(block).second) compulsory[isWrite]++;
+        else if (shadowHit) conflict[isWrite]++;
+        else capacity[isWrite]++;
+    }
+
+    long misses() const {
+        return compulsory[0] + compulsory[1] + capacity[0] + capacity[1] + conflict[0] + conflict[1];
+    }
+};
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef COMPOSED_H
+#define COMPOSED_H
+
+#include <type_traits>
+#include "hierarchy.h"
+
+///////////////////////////////////////////////////////////////////////////
+// Compile-time composed hierarchies
+//
+//    BasicCache finds its next level and victim cache through pointers
+//    that are tested on every miss, so nothing across levels inlines.
+//    Here each hierarchy shape is one type instead, CacheLevel chained by
+//    value:
+//
+//       L1+VC -> L2 -> memory =
+//          CacheLevel<P, InlineNext<CacheLevel<P, MainMemory, NoVictimCache> >, InlineVictimCache>
+//
+//    so the VC and next-level tests are constants and the L2 access is a
+//    direct call the compiler can inline into the L1 miss path. The four
+//    shapes of the command line (with or without a VC, with or without an
+//    L2) are instantiated for every replacement policy, and
+//    dispatchComposedShape picks one from a CacheConfig.
+//
+//    The per-access logic is CacheLevel's in both cases, so a composed
+//    hierarchy produces exactly the statistics of BasicHierarchy.
+///////////////////////////////////////////////////////////////////////////
+
+template <class Policy>
+struct ComposedLevels {
+    typedef CacheLevel<Policy, MainMemory, NoVictimCache> L2;
+    typedef CacheLevel<Policy, MainMemory, NoVictimCache> L1;
+    typedef CacheLevel<Policy, MainMemory, InlineVictimCache> L1VC;
+    typedef CacheLevel<Policy, InlineNext<L2>, NoVictimCache> L1L2;
+    typedef CacheLevel<Policy, InlineNext<L2>, InlineVictimCache> L1VCL2;
+};
+
+// Build the next-level slot of an L1 from a CacheConfig
+inline MainMemory makeNextLevel(const CacheConfig &, MainMemory *) { return MainMemory(); }
+
+template <class L2>
+InlineNext<L2> makeNextLevel(const CacheConfig &cfg, InlineNext<L2> *) {
+    return InlineNext<L2>(L2(cfg.L2_SIZE, cfg.L2_ASSOC, cfg.L1_BLOCKSIZE, MainMemory(), NoVictimCache()));
+}
+
+// The L2 inside an L1's next-level slot, or nullptr
+template <class L2>
+L2 *nextLevelCache(InlineNext<L2> &next, L2 *) { return &next.level; }
+
+template <class L2>
+L2 *nextLevelCache(MainMemory &, L2 *) { return nullptr; }
+
+// A whole hierarchy with L1 type L1Level. Mirrors BasicHierarchy:
+// l1Cache/l2Cache point at the levels (l2Cache is nullptr without L2).
+template <class Policy, class L1Level>
+class ComposedHierarchy {
+private:
+    L1Level l1;
+
+public:
+    typedef typename ComposedLevels<Policy>::L2 L2Level;
+
+    CacheConfig config;
+    L2Level *l2Cache;
+    L1Level *l1Cache;
+
+    ComposedHierarchy(const CacheConfig &cfg)
+        : l1(cfg.L1_SIZE, cfg.L1_ASSOC, cfg.L1_BLOCKSIZE,
+             makeNextLevel(cfg, (typename L1Level::NextType *)nullptr),
+             typename L1Level::VictimType(cfg.VC_NUM_BLOCKS, cfg.L1_BLOCKSIZE)),
+          config(cfg), l2Cache(nullptr), l1Cache(&l1) {
+        l2Cache = nextLevelCache(l1.nextLevel(), (L2Level *)nullptr);
+    }
+    ComposedHierarchy(const ComposedHierarchy &) = delete;
+    ComposedHierarchy &operator=(const ComposedHierarchy &) = delete;
+
+    void access(char type, unsigned long address) {
+        if (type == 'r') l1.handleRead(address);
+        else l1.handleWrite(address);
+    }
+    void access(const Access *records, size_t n) { l1.handleBatch(records, n); }
+    void access(const uint64_t *addresses, const uint8_t *ops, size_t n) { l1.handleBatch(addresses, ops, n); }
+    // Functional warming: state only, no statistics (see sampling.h)
+    void warm(char type, unsigned long address) { l1.warm(address, type != 'r'); }
+
+    // The level that writes to memory
+    template <class F>
+    void lastLevel(F f) {
+        if (l2Cache) f(*l2Cache);
+        else f(l1);
+    }
+};
+
+// Call f with a null ComposedHierarchy<Policy, ...>* naming the type that
+// matches cfg's shape, and return its result. f is usually a generic
+// lambda that constructs the hierarchy it is handed the type of.
+template <class Policy, class F>
+auto dispatchComposedShape(const CacheConfig &cfg, F f)
+    -> decltype(f((ComposedHierarchy<Policy, typename ComposedLevels<Policy>::L1> *)nullptr)) {
+    typedef ComposedLevels<Policy> Levels;
+    bool vc = cfg.VC_NUM_BLOCKS > 0, l2 = cfg.L2_SIZE > 0;
+    if (vc && l2) return f((ComposedHierarchy<Policy, typename Levels::L1VCL2> *)nullptr);
+    if (l2) return f((ComposedHierarchy<Policy, typename Levels::L1L2> *)nullptr);
+    if (vc) return f((ComposedHierarchy<Policy, typename Levels::L1VC> *)nullptr);
+    return f((ComposedHierarchy<Policy, typename Levels::L1> *)nullptr);
+}
+
+// A composed hierarchy behind one virtual call per batch of accesses, for
+// code that keeps many hierarchies of different shapes (see sweep.h and
+// libcachesim.cpp)
+class HierarchyRunner {
+public:
+    virtual ~HierarchyRunner() {}
+    virtual void access(const Access *records, size_t n) = 0;
+    virtual void access(const uint64_t *addresses, const uint8_t *ops, size_t n) = 0;
+    virtual SimStats stats() const = 0;
+    // Level 0 is L1, 1 is L2 (ignored without one); see CacheLevel
+    virtual void setWritePolicy(int level, bool writeBack, bool writeAllocate) = 0;
+    // In front of memory, after the last level (nullptr to remove)
+    virtual void setWriteBuffer(WriteBuffer *b) = 0;
+};
+
+template <class H>
+class ComposedRunner : public HierarchyRunner {
+private:
+    H hierarchy;
+
+public:
+    ComposedRunner(const CacheConfig &cfg) : hierarchy(cfg) {}
+    void access(const Access *records, size_t n) { hierarchy.access(records, n); }
+    void access(const uint64_t *addresses, const uint8_t *ops, size_t n) { hierarchy.access(addresses, ops, n); }
+    SimStats stats() const { return SimStats(hierarchy); }
+    void setWritePolicy(int level, bool writeBack, bool writeAllocate) {
+        if (level == 0) hierarchy.l1Cache->setWritePolicy(writeBack, writeAllocate);
+        else if (hierarchy.l2Cache) hierarchy.l2Cache->setWritePolicy(writeBack, writeAllocate);
+    }
+    void setWriteBuffer(WriteBuffer *b) {
+        hierarchy.lastLevel([b](auto &level) { level.setWriteBuffer(b); });
+    }
+};
+
+template <class Policy>
+HierarchyRunner *makeComposedRunner(const CacheConfig &cfg) {
+    return dispatchComposedShape<Policy>(cfg, [&](auto *tag) -> HierarchyRunner * {
+        typedef typename std::remove_pointer<decltype(tag)>::type H;
+        return new ComposedRunner<H>(cfg);
+    });
+}
+
+#endif
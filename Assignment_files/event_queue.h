@@ -0,0 +1,73 @@
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <atomic>
+#include <thread>
+#include "pipeline.h"
+
+///////////////////////////////////////////////////////////////////////////
+// Ordered request stream between two cache levels
+//
+//    When a BasicCache has an EventQueue attached, requests it would send
+//    to nextLevelCache ('r' fills, 'w' writes) are appended to the queue
+//    instead, and the next level consumes them on its own thread through
+//    consumeEvents(). The next level's state depends only on the order of
+//    that stream, so its statistics are identical to calling it inline.
+///////////////////////////////////////////////////////////////////////////
+
+#define EVENT_QUEUE_SLOTS 16
+
+class EventQueue {
+private:
+    SpscRing<AccessBatch, EVENT_QUEUE_SLOTS> ring;
+    std::atomic<bool> closed;
+    AccessBatch *filling;
+
+    AccessBatch *nextSlot() {
+        AccessBatch *b;
+        while (!(b = ring.acquire())) std::this_thread::yield();
+        b->count = 0;
+        return b;
+    }
+
+public:
+    EventQueue() : closed(false), filling(nullptr) {}
+
+    // Producer side
+    void push(char type, unsigned long address) {
+        if (!filling) filling = nextSlot();
+        filling->records[filling->count++] = Access{address, type};
+        if (filling->count == PIPELINE_BATCH) {
+            ring.push();
+            filling = nullptr;
+        }
+    }
+    // Publish the partial batch and mark the end of the stream
+    void close() {
+        if (filling && filling->count > 0) ring.push();
+        filling = nullptr;
+        closed.store(true, std::memory_order_release);
+    }
+
+    // Consumer side: next batch, or nullptr at the end of the stream
+    const AccessBatch *next() {
+        for (;;) {
+            AccessBatch *b = ring.front();
+            if (b) return b;
+            if (closed.load(std::memory_order_acquire)) return ring.front();
+            std::this_thread::yield();
+        }
+    }
+    void release() { ring.pop(); }
+};
+
+// Feed every event of queue to cache until the producer closes it
+template <class C>
+void consumeEvents(EventQueue &queue, C &cache) {
+    while (const AccessBatch *b = queue.next()) {
+        cache.handleBatch(b->records, b->count);
+        queue.release();
+    }
+}
+
+#endif
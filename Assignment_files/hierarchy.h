@@ -0,0 +1,137 @@
+#ifndef HIERARCHY_H
+#define HIERARCHY_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "trace.h"
+#include "pipeline.h"
+
+// One simulator configuration, same fields as the command line
+struct CacheConfig {
+    int L1_SIZE;
+    int L1_ASSOC;
+    int L1_BLOCKSIZE;
+    int VC_NUM_BLOCKS;
+    int L2_SIZE;
+    int L2_ASSOC;
+
+    // True if both levels divide into a whole, non-zero number of sets
+    bool valid() const {
+        if (L1_SIZE <= 0 || L1_ASSOC <= 0 || L1_BLOCKSIZE <= 0 || VC_NUM_BLOCKS < 0 || L2_SIZE < 0) return false;
+        if (L1_SIZE % (L1_BLOCKSIZE * L1_ASSOC) != 0) return false;
+        if (L2_SIZE > 0 && (L2_ASSOC <= 0 || L2_SIZE % (L1_BLOCKSIZE * L2_ASSOC) != 0)) return false;
+        return true;
+    }
+};
+
+// CPU -> L1 (+VC) -> optional L2, built from a CacheConfig
+template <class Policy>
+class BasicHierarchy {
+public:
+    CacheConfig config;
+    BasicCache<Policy> *l2Cache;
+    BasicCache<Policy> *l1Cache;
+
+    BasicHierarchy(const CacheConfig &cfg) : config(cfg), l2Cache(nullptr), l1Cache(nullptr) {
+        if (cfg.L2_SIZE > 0) {
+            l2Cache = new BasicCache<Policy>(cfg.L2_SIZE, cfg.L2_ASSOC, cfg.L1_BLOCKSIZE);
+        }
+        l1Cache = new BasicCache<Policy>(cfg.L1_SIZE, cfg.L1_ASSOC, cfg.L1_BLOCKSIZE, l2Cache, cfg.VC_NUM_BLOCKS);
+    }
+    ~BasicHierarchy() {
+        delete l1Cache;
+        delete l2Cache;
+    }
+    BasicHierarchy(const BasicHierarchy &) = delete;
+    BasicHierarchy &operator=(const BasicHierarchy &) = delete;
+
+    void access(char type, unsigned long address) {
+        if (type == 'r') l1Cache->handleRead(address);
+        else l1Cache->handleWrite(address);
+    }
+    void access(const Access *records, size_t n) { l1Cache->handleBatch(records, n); }
+
+    // True if the policy can manage both levels' associativities
+    static bool supports(const CacheConfig &cfg) {
+        return Policy::supports(cfg.L1_ASSOC) && (cfg.L2_SIZE == 0 || Policy::supports(cfg.L2_ASSOC));
+    }
+};
+
+typedef BasicHierarchy<LRUPolicy> Hierarchy;
+
+// The raw a-p results of one run
+struct SimStats {
+    long l1Reads, l1ReadMisses, l1Writes, l1WriteMisses, swapRequests, swaps, l1Writebacks;
+    long l2Reads, l2ReadMisses, l2Writes, l2WriteMisses, l2Writebacks;
+    bool hasL2;
+    long l1Fetches, l1WriteThroughs, l2Fetches, l2WriteThroughs; // see CacheLevel
+    long coalescedWrites; // merged by a write buffer in front of memory
+
+    // From a BasicHierarchy or a ComposedHierarchy (see composed.h)
+    template <class H>
+    SimStats(const H &h) {
+        const auto &l1 = *h.l1Cache;
+        l1Reads = l1.numReads;
+        l1ReadMisses = l1.numReadMisses;
+        l1Writes = l1.numWrites;
+        l1WriteMisses = l1.numWriteMisses;
+        swapRequests = l1.numSwapRequests;
+        swaps = l1.numSwaps;
+        l1Writebacks = l1.numWritebacks;
+        l1Fetches = l1.numFetches;
+        l1WriteThroughs = l1.numWriteThroughs;
+        const auto *l2 = h.l2Cache;
+        hasL2 = l2 != nullptr;
+        l2Reads = l2 ? l2->numReads : 0;
+        l2ReadMisses = l2 ? l2->numReadMisses : 0;
+        l2Writes = l2 ? l2->numWrites : 0;
+        l2WriteMisses = l2 ? l2->numWriteMisses : 0;
+        l2Writebacks = l2 ? l2->numWritebacks : 0;
+        l2Fetches = l2 ? l2->numFetches : 0;
+        l2WriteThroughs = l2 ? l2->numWriteThroughs : 0;
+        coalescedWrites = l2 ? l2->coalescedWrites() : l1.coalescedWrites();
+    }
+
+    double swapRequestRate() const {
+        return l1Reads + l1Writes > 0 ? static_cast<double>(swapRequests) / (l1Reads + l1Writes) : 0;
+    }
+    double l1MissRate() const {
+        return l1Reads + l1Writes > 0 ? static_cast<double>(l1ReadMisses + l1WriteMisses - swaps) / (l1Reads + l1Writes) : 0;
+    }
+    double l2MissRate() const {
+        return l2Reads > 0 ? static_cast<double>(l2ReadMisses) / l2Reads : 0;
+    }
+    // Blocks moved to and from memory by the last level: fetches (misses
+    // and prefetches), dirty writebacks and forwarded writes, less the
+    // writes a write buffer merged
+    long memoryTraffic() const {
+        long traffic = hasL2 ? l2Fetches + l2Writebacks + l2WriteThroughs : l1Fetches + l1Writebacks + l1WriteThroughs;
+        return traffic - coalescedWrites;
+    }
+};
+
+// Decode a whole trace (text, .gz or binary) into memory
+inline bool loadTrace(const std::string &path, std::vector<Access> &accesses) {
+    accesses.clear();
+    if (isBinaryTrace(path.c_str())) {
+        MappedTrace mapped;
+        if (!mapped.open(path.c_str())) return false;
+        accesses.reserve(mapped.numRecords);
+        mapped.forEach([&](char type, unsigned long address) {
+            accesses.push_back(Access{address, type});
+        });
+        return true;
+    }
+    TracePipeline pipeline;
+    if (!pipeline.open(path)) return false;
+    bool ok = pipeline.forEach([&](char type, unsigned long address) {
+        accesses.push_back(Access{address, type});
+    });
+    if (!ok) std::cerr << pipeline.getError() << "\n";
+    return ok;
+}
+
+#endif
@@ -0,0 +1,187 @@
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#define CACHE_SIM_THROW
+#include "cache_sim.cc"
+#include "composed.h"
+#include "libcachesim.h"
+
+// The C ABI of libcachesim.h over a HierarchyRunner. Nothing here may
+// throw across the ABI, so allocation failures and the simulator's own
+// failures (CACHE_SIM_THROW) become errors.
+
+// One library instantiation per replacement policy, selected by name
+struct LibPolicy {
+    const char *name;
+    HierarchyRunner *(*make)(const CacheConfig &);
+    bool (*supports)(const CacheConfig &);
+};
+
+static const LibPolicy libPolicies[] = {
+    {LRUPolicy::name(), makeComposedRunner<LRUPolicy>, BasicHierarchy<LRUPolicy>::supports},
+    {TreePLRUPolicy::name(), makeComposedRunner<TreePLRUPolicy>, BasicHierarchy<TreePLRUPolicy>::supports},
+    {SRRIPPolicy::name(), makeComposedRunner<SRRIPPolicy>, BasicHierarchy<SRRIPPolicy>::supports},
+    {BRRIPPolicy::name(), makeComposedRunner<BRRIPPolicy>, BasicHierarchy<BRRIPPolicy>::supports},
+    {RandomPolicy::name(), makeComposedRunner<RandomPolicy>, BasicHierarchy<RandomPolicy>::supports},
+};
+
+static thread_local std::string lastError;
+
+struct cachesim {
+    cachesim_config config;
+    std::string policyName; // config.policy points here
+    const LibPolicy *policy;
+    std::unique_ptr<HierarchyRunner> runner;
+    std::unique_ptr<WriteBuffer> writeBuffer;
+
+    cachesim() : policy(nullptr) {}
+
+    // A cold hierarchy of the current config
+    void build() {
+        CacheConfig cfg = {config.l1_size, config.l1_assoc, config.l1_blocksize,
+                           config.vc_num_blocks, config.l2_size, config.l2_assoc};
+        runner.reset(policy->make(cfg));
+        runner->setWritePolicy(0, config.l1_write_back, config.l1_write_allocate);
+        runner->setWritePolicy(1, config.l2_write_back, config.l2_write_allocate);
+        writeBuffer.reset(config.write_buffer > 0 ? new WriteBuffer(config.write_buffer) : nullptr);
+        runner->setWriteBuffer(writeBuffer.get());
+    }
+};
+
+// The policy cfg names if cfg is a valid hierarchy, else nullptr with
+// lastError set
+static const LibPolicy *checkConfig(const cachesim_config *cfg) {
+    if (!cfg) {
+        lastError = "No configuration";
+        return nullptr;
+    }
+    CacheConfig c = {cfg->l1_size, cfg->l1_assoc, cfg->l1_blocksize, cfg->vc_num_blocks, cfg->l2_size, cfg->l2_assoc};
+    if (!c.valid()) {
+        lastError = "Cache sizes must divide into whole sets";
+        return nullptr;
+    }
+    if (cfg->write_buffer < 0) {
+        lastError = "Write buffer entries must not be negative";
+        return nullptr;
+    }
+    std::string name = cfg->policy ? cfg->policy : "lru";
+    for (const LibPolicy &p : libPolicies) {
+        if (name != p.name) continue;
+        if (!p.supports(c)) {
+            lastError = "Replacement policy " + name + " does not support this associativity";
+            return nullptr;
+        }
+        return &p;
+    }
+    lastError = "Unknown replacement policy: " + name;
+    return nullptr;
+}
+
+extern "C" {
+
+int cachesim_abi_version(void) { return CACHESIM_ABI_VERSION; }
+
+void cachesim_config_init(cachesim_config *cfg) {
+    if (!cfg) return;
+    cfg->l1_size = cfg->l1_assoc = cfg->l1_blocksize = 0;
+    cfg->vc_num_blocks = cfg->l2_size = cfg->l2_assoc = 0;
+    cfg->policy = "lru";
+    cfg->l1_write_back = cfg->l1_write_allocate = 1;
+    cfg->l2_write_back = cfg->l2_write_allocate = 1;
+    cfg->write_buffer = 0;
+}
+
+cachesim_t *cachesim_create(const cachesim_config *cfg) {
+    cachesim_t *sim = new (std::nothrow) cachesim();
+    if (!sim) {
+        lastError = "Out of memory";
+        return nullptr;
+    }
+    if (cachesim_configure(sim, cfg) != 0) {
+        delete sim;
+        return nullptr;
+    }
+    return sim;
+}
+
+int cachesim_configure(cachesim_t *sim, const cachesim_config *cfg) {
+    if (!sim) {
+        lastError = "No simulator";
+        return -1;
+    }
+    const LibPolicy *policy = checkConfig(cfg);
+    if (!policy) return -1;
+    try {
+        cachesim_t next;
+        next.config = *cfg;
+        next.policyName = policy->name;
+        next.config.policy = next.policyName.c_str();
+        next.policy = policy;
+        next.build();
+        sim->config = next.config;
+        sim->policyName.swap(next.policyName);
+        sim->config.policy = sim->policyName.c_str();
+        sim->policy = policy;
+        sim->runner.swap(next.runner);
+        sim->writeBuffer.swap(next.writeBuffer);
+    } catch (const std::bad_alloc &) {
+        lastError = "Out of memory";
+        return -1;
+    } catch (const std::exception &e) {
+        lastError = e.what();
+        return -1;
+    }
+    return 0;
+}
+
+void cachesim_destroy(cachesim_t *sim) { delete sim; }
+
+int cachesim_simulate_batch(cachesim_t *sim, const uint64_t *addrs, const uint8_t *ops, size_t n) {
+    if (!sim) {
+        lastError = "No simulator";
+        return -1;
+    }
+    try {
+        sim->runner->access(addrs, ops, n);
+    } catch (const std::bad_alloc &) {
+        lastError = "Out of memory";
+        return -1;
+    } catch (const std::exception &e) {
+        lastError = e.what();
+        return -1;
+    }
+    return 0;
+}
+
+void cachesim_get_stats(const cachesim_t *sim, cachesim_stats *out) {
+    if (!sim || !out) return;
+    SimStats s = sim->runner->stats();
+    out->l1_reads = s.l1Reads;
+    out->l1_read_misses = s.l1ReadMisses;
+    out->l1_writes = s.l1Writes;
+    out->l1_write_misses = s.l1WriteMisses;
+    out->swap_requests = s.swapRequests;
+    out->swaps = s.swaps;
+    out->l1_writebacks = s.l1Writebacks;
+    out->l2_reads = s.l2Reads;
+    out->l2_read_misses = s.l2ReadMisses;
+    out->l2_writes = s.l2Writes;
+    out->l2_write_misses = s.l2WriteMisses;
+    out->l2_writebacks = s.l2Writebacks;
+    out->memory_traffic = s.memoryTraffic();
+    out->coalesced_writes = s.coalescedWrites;
+    out->swap_request_rate = s.swapRequestRate();
+    out->l1_vc_miss_rate = s.l1MissRate();
+    out->l2_miss_rate = s.l2MissRate();
+}
+
+void cachesim_reset(cachesim_t *sim) {
+    // A cold hierarchy of the same configuration (the old one stays if
+    // that runs out of memory)
+    if (sim) cachesim_configure(sim, &sim->config);
+}
+
+const char *cachesim_last_error(void) { return lastError.c_str(); }
+
+}
@@ -0,0 +1,103 @@
+#ifndef LIBCACHESIM_H
+#define LIBCACHESIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////
+// libcachesim: the simulator as a library with a C ABI (make lib)
+//
+//    Builds libcachesim.so and libcachesim.a. Link the static one with
+//    -lstdc++ -pthread. Only the cachesim_* functions are exported.
+//
+//       cachesim_config cfg;
+//       cachesim_config_init(&cfg);
+//       cfg.l1_size = 1024; cfg.l1_assoc = 2; cfg.l1_blocksize = 16;
+//       cachesim_t *sim = cachesim_create(&cfg);
+//       if (!sim) fprintf(stderr, "%s\n", cachesim_last_error());
+//       cachesim_simulate_batch(sim, addrs, ops, n);
+//       cachesim_stats s;
+//       cachesim_get_stats(sim, &s);
+//       cachesim_destroy(sim);
+//
+//    A batch is simulated in place from the caller's arrays, with no copy
+//    and no call per access, so an in-process tracer or a numpy array
+//    (through ctypes, arr.ctypes.data) can hand over millions of
+//    accesses at a time. Batches continue one another: the result is the
+//    same however a stream is split into batches.
+//
+//    The hierarchy is the command line's (L1 + optional VC + optional L2),
+//    simulated as a composed type (see composed.h). A handle must not be
+//    used by two threads at once; separate handles are independent.
+///////////////////////////////////////////////////////////////////////////
+
+#define CACHESIM_ABI_VERSION 1
+
+#if defined(__GNUC__)
+#define CACHESIM_API __attribute__((visibility("default")))
+#else
+#define CACHESIM_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cachesim cachesim_t;
+
+// Values of ops[] in cachesim_simulate_batch (any non-zero op is a write)
+enum { CACHESIM_READ = 0, CACHESIM_WRITE = 1 };
+
+typedef struct cachesim_config {
+    // The six command line parameters; VC and L2 are absent when 0
+    int l1_size, l1_assoc, l1_blocksize, vc_num_blocks, l2_size, l2_assoc;
+    const char *policy; // replacement policy: lru, plru, srrip, brrip or random
+    int l1_write_back, l1_write_allocate; // booleans, else write-through / no-write-allocate
+    int l2_write_back, l2_write_allocate;
+    int write_buffer; // coalescing write buffer entries in front of memory, 0 for none
+} cachesim_config;
+
+// The a-p results of the command line, plus what the write buffer merged
+typedef struct cachesim_stats {
+    int64_t l1_reads, l1_read_misses, l1_writes, l1_write_misses;
+    int64_t swap_requests, swaps, l1_writebacks;
+    int64_t l2_reads, l2_read_misses, l2_writes, l2_write_misses, l2_writebacks;
+    int64_t memory_traffic, coalesced_writes;
+    double swap_request_rate, l1_vc_miss_rate, l2_miss_rate;
+} cachesim_stats;
+
+// CACHESIM_ABI_VERSION of the library, for callers that load it at run time
+CACHESIM_API int cachesim_abi_version(void);
+
+// Defaults: no caches (sizes 0), LRU, write-back and write-allocate
+// everywhere, no write buffer
+CACHESIM_API void cachesim_config_init(cachesim_config *cfg);
+
+// A cold hierarchy of cfg, or NULL if cfg is invalid (see
+// cachesim_last_error)
+CACHESIM_API cachesim_t *cachesim_create(const cachesim_config *cfg);
+// Replace the hierarchy with a cold one of cfg. Returns 0, or -1 and
+// leaves the old one in place if cfg is invalid.
+CACHESIM_API int cachesim_configure(cachesim_t *sim, const cachesim_config *cfg);
+CACHESIM_API void cachesim_destroy(cachesim_t *sim);
+
+// Access addrs[0..n) in order, access i a write iff ops[i] is non-zero
+// (all reads if ops is NULL). Returns 0, or -1 if sim is NULL or an
+// access can't be simulated (see cachesim_last_error), in which case the
+// statistics cover only part of the batch until cachesim_reset.
+CACHESIM_API int cachesim_simulate_batch(cachesim_t *sim, const uint64_t *addrs, const uint8_t *ops, size_t n);
+
+// Statistics of everything simulated since creation or the last reset
+CACHESIM_API void cachesim_get_stats(const cachesim_t *sim, cachesim_stats *out);
+
+// Empty every level and zero the statistics, keeping the configuration
+CACHESIM_API void cachesim_reset(cachesim_t *sim);
+
+// Why the last failing call on this thread failed
+CACHESIM_API const char *cachesim_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,307 @@
+#ifndef MULTICORE_H
+#define MULTICORE_H
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include "barrier.h"
+#include "hierarchy.h"
+
+///////////////////////////////////////////////////////////////////////////
+// Multi-core mode: one trace per core, private L1s sharing an L2
+//
+//    cache_sim --multicore [--policy P] [--epoch N] [-j threads]
+//              <L1_SIZE> <L1_ASSOC> <L1_BLOCKSIZE> <VC_NUM_BLOCKS> <L2_SIZE> <L2_ASSOC>
+//              <trace_core0> [<trace_core1> ...]
+//
+//    Every core has its own L1 (+VC), and the cores run on host worker
+//    threads in epochs of N accesses per core. Within an epoch a core
+//    touches only its own L1. Its L2 requests are recorded with the
+//    offset of the access that made them, and so are the blocks it wrote.
+//
+//    Between epochs:
+//
+//       - the shared L2 replays every core's requests of the epoch,
+//         ordered by (offset, core). That is a round-robin interleaving
+//         of the cores at access granularity.
+//       - each core invalidates, in its L1 and VC, every block another
+//         core wrote during the epoch, writing back its own copy first
+//         if that is dirty.
+//
+//    The L2 replay of epoch e runs on the main thread while the cores
+//    simulate epoch e+1, because the L2 never sends anything back to an
+//    L1. Results depend only on N, never on the number of host threads.
+//    Coherence is relaxed to epoch granularity: a write becomes visible
+//    to the other cores at the end of its epoch. Smaller epochs are more
+//    faithful, larger ones synchronize less. One core reproduces the
+//    single-core simulation exactly.
+///////////////////////////////////////////////////////////////////////////
+
+#define MULTICORE_DEFAULT_EPOCH 10000
+
+// An L2 request of one core ('r' fill or 'w' writeback), at `when`
+// accesses into the epoch
+struct CoreRequest {
+    unsigned long address;
+    uint64_t when;
+    char type;
+};
+
+// Per-core epoch buffers, double-buffered by epoch parity so the main
+// thread can drain one epoch while the core fills the next
+struct CoreContext {
+    std::vector<CoreRequest> requests[2]; // L2 reads and writes
+    std::vector<unsigned long> writes[2]; // blocks written, sorted and unique once the epoch ends
+    std::vector<CoreRequest> *current;
+    uint64_t clock;                       // offset of the access being simulated
+    long invalidations;                   // blocks removed by other cores' writes
+
+    CoreContext() : current(&requests[0]), clock(0), invalidations(0) {}
+};
+
+// Next-level slot of a core's L1: requests are recorded for the L2 replay
+struct CoreNext {
+    CoreContext *core;
+    bool hasL2;
+
+    CoreNext(CoreContext *c, bool l2) : core(c), hasL2(l2) {}
+    bool present() const { return hasL2; }
+    void read(unsigned long address) { core->current->push_back(CoreRequest{address, core->clock, 'r'}); }
+    void write(unsigned long address) { core->current->push_back(CoreRequest{address, core->clock, 'w'}); }
+};
+
+template <class Policy>
+class MulticoreHierarchy {
+public:
+    typedef CacheLevel<Policy, CoreNext, DynamicVictimCache> L1Level;
+    typedef CacheLevel<Policy, MainMemory, NoVictimCache> L2Level;
+
+    CacheConfig config;
+    std::vector<std::unique_ptr<CoreContext> > cores;
+    std::vector<std::unique_ptr<L1Level> > l1Caches;
+    L2Level *l2Cache;
+
+    MulticoreHierarchy(const CacheConfig &cfg, int numCores) : config(cfg), l2Cache(nullptr) {
+        if (cfg.L2_SIZE > 0) l2Cache = new L2Level(cfg.L2_SIZE, cfg.L2_ASSOC, cfg.L1_BLOCKSIZE, MainMemory(), NoVictimCache());
+        for (int c = 0; c < numCores; ++c) {
+            cores.emplace_back(new CoreContext());
+            l1Caches.emplace_back(new L1Level(cfg.L1_SIZE, cfg.L1_ASSOC, cfg.L1_BLOCKSIZE,
+                                              CoreNext(cores.back().get(), l2Cache != nullptr),
+                                              DynamicVictimCache(cfg.VC_NUM_BLOCKS, cfg.L1_BLOCKSIZE)));
+        }
+    }
+    ~MulticoreHierarchy() { delete l2Cache; }
+    MulticoreHierarchy(const MulticoreHierarchy &) = delete;
+    MulticoreHierarchy &operator=(const MulticoreHierarchy &) = delete;
+
+    int numCores() const { return (int)cores.size(); }
+
+    // Core c's part of epoch e: accesses [begin, end) of its trace, after
+    // applying the other cores' writes of epoch e-1
+    void runEpoch(int c, uint64_t e, const Access *trace, size_t begin, size_t end) {
+        CoreContext &core = *cores[c];
+        L1Level &l1 = *l1Caches[c];
+        int p = e & 1;
+        core.requests[p].clear();
+        core.writes[p].clear();
+        core.current = &core.requests[p];
+        // Writebacks of dirty invalidated blocks reach the L2 ahead of
+        // the epoch's own requests
+        core.clock = 0;
+        if (e > 0) {
+            for (int other = 0; other < numCores(); ++other) {
+                if (other == c) continue;
+                for (unsigned long block : cores[other]->writes[p ^ 1]) {
+                    if (l1.invalidate(block * config.L1_BLOCKSIZE)) core.invalidations++;
+                }
+            }
+        }
+        for (size_t i = begin; i < end; ++i) {
+            core.clock = i - begin;
+            if (trace[i].type == 'r') {
+                l1.handleRead(trace[i].address);
+            } else {
+                l1.handleWrite(trace[i].address);
+                core.writes[p].push_back(l1.getTag(trace[i].address));
+            }
+        }
+        std::vector<unsigned long> &w = core.writes[p];
+        std::sort(w.begin(), w.end());
+        w.erase(std::unique(w.begin(), w.end()), w.end());
+    }
+
+    // Replay the L2 requests of the epoch with parity p in (when, core) order
+    void mergeEpoch(int p) {
+        if (!l2Cache) return;
+        std::vector<size_t> next(numCores(), 0);
+        for (;;) {
+            int pick = -1;
+            uint64_t when = 0;
+            for (int c = 0; c < numCores(); ++c) {
+                const std::vector<CoreRequest> &r = cores[c]->requests[p];
+                if (next[c] < r.size() && (pick < 0 || r[next[c]].when < when)) {
+                    pick = c;
+                    when = r[next[c]].when;
+                }
+            }
+            if (pick < 0) break;
+            const CoreRequest &r = cores[pick]->requests[p][next[pick]++];
+            if (r.type == 'r') l2Cache->handleRead(r.address);
+            else l2Cache->handleWrite(r.address);
+        }
+    }
+
+    // Simulate traces[c] on core c in epochs of epochLength accesses, with
+    // the cores spread over nthreads worker threads
+    void run(const std::vector<std::vector<Access> > &traces, uint64_t epochLength, int nthreads) {
+        if (nthreads < 1) nthreads = 1;
+        if (nthreads > numCores()) nthreads = numCores();
+        size_t longest = 0;
+        for (const std::vector<Access> &t : traces) longest = std::max(longest, t.size());
+        uint64_t numEpochs = (longest + epochLength - 1) / epochLength;
+
+        // Each epoch: start barrier, cores simulate while the main thread
+        // merges the previous epoch, end barrier
+        EpochBarrier barrier(nthreads + 1);
+        uint64_t epoch = 0;
+        std::vector<std::thread> workers;
+        for (int t = 0; t < nthreads; ++t) {
+            workers.emplace_back([&, t]() {
+                for (;;) {
+                    barrier.wait();
+                    if (epoch == numEpochs) return;
+                    size_t begin = epoch * epochLength;
+                    for (int c = t; c < numCores(); c += nthreads) {
+                        size_t size = traces[c].size();
+                        size_t end = std::min(size, begin + (size_t)epochLength);
+                        runEpoch(c, epoch, traces[c].data(), std::min(begin, size), end);
+                    }
+                    barrier.wait();
+                }
+            });
+        }
+        for (; epoch < numEpochs; ++epoch) {
+            barrier.wait();
+            if (epoch > 0) mergeEpoch((epoch - 1) & 1);
+            barrier.wait();
+        }
+        if (numEpochs > 0) mergeEpoch((numEpochs - 1) & 1);
+        barrier.wait(); // releases the workers with epoch == numEpochs
+        for (std::thread &w : workers) w.join();
+    }
+};
+
+// One core's L1 as a hierarchy without L2, for SimStats
+template <class L1Level>
+struct CoreStatsView {
+    const L1Level *l1Cache;
+    const L1Level *l2Cache; // always nullptr
+};
+
+template <class Policy>
+void printMulticoreResults(const MulticoreHierarchy<Policy> &h, const std::vector<std::string> &traceFiles) {
+    typedef typename MulticoreHierarchy<Policy>::L1Level L1Level;
+    for (int c = 0; c < h.numCores(); ++c) {
+        SimStats s(CoreStatsView<L1Level>{h.l1Caches[c].get(), nullptr});
+        std::cout << "===== Core " << c << " (" << traceFiles[c] << ") =====\n";
+        std::cout << "  a. number of L1 reads:\t\t\t" << s.l1Reads << "\n";
+        std::cout << "  b. number of L1 read misses:\t\t\t" << s.l1ReadMisses << "\n";
+        std::cout << "  c. number of L1 writes:\t\t\t" << s.l1Writes << "\n";
+        std::cout << "  d. number of L1 write misses:\t\t\t" << s.l1WriteMisses << "\n";
+        std::cout << "  e. number of swap requests:\t\t\t" << s.swapRequests << "\n";
+        std::cout << "  g. number of swaps:\t\t\t\t" << s.swaps << "\n";
+        std::cout << "  h. combined L1+VC miss rate:\t\t\t" << std::fixed << std::setprecision(4) << s.l1MissRate() << "\n";
+        std::cout << "  i. number writebacks from L1/VC:\t\t" << s.l1Writebacks << "\n";
+        std::cout << "  coherence invalidations received:\t\t" << h.cores[c]->invalidations << "\n";
+    }
+    if (h.l2Cache) {
+        const typename MulticoreHierarchy<Policy>::L2Level &l2 = *h.l2Cache;
+        std::cout << "===== Shared L2 =====\n";
+        std::cout << "  j. number of L2 reads:\t\t\t" << l2.numReads << "\n";
+        std::cout << "  k. number of L2 read misses:\t\t\t" << l2.numReadMisses << "\n";
+        std::cout << "  l. number of L2 writes:\t\t\t" << l2.numWrites << "\n";
+        std::cout << "  n. L2 miss rate:\t\t\t\t" << std::fixed << std::setprecision(4)
+                  << (l2.numReads > 0 ? (double)l2.numReadMisses / l2.numReads : 0) << "\n";
+        std::cout << "  o. number of writebacks from L2:\t\t" << l2.numWritebacks << "\n";
+    }
+}
+
+template <class Policy>
+int runMulticoreWith(const CacheConfig &cfg, const std::vector<std::string> &traceFiles, uint64_t epochLength,
+                     int nthreads) {
+    std::vector<std::vector<Access> > traces(traceFiles.size());
+    for (size_t c = 0; c < traceFiles.size(); ++c) {
+        if (!traceSupportsBlockSize(traceFiles[c], cfg.L1_BLOCKSIZE)) return EXIT_FAILURE;
+        if (!loadTrace(traceFiles[c], traces[c])) {
+            std::cerr << "Error opening trace file: " << traceFiles[c] << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    MulticoreHierarchy<Policy> h(cfg, traceFiles.size());
+    h.run(traces, epochLength, nthreads);
+    printMulticoreResults(h, traceFiles);
+    return 0;
+}
+
+// One multi-core instantiation per replacement policy, selected by --policy
+struct MulticorePolicy {
+    const char *name;
+    int (*run)(const CacheConfig &, const std::vector<std::string> &, uint64_t, int);
+    bool (*supports)(const CacheConfig &);
+};
+
+static const MulticorePolicy multicorePolicies[] = {
+    {LRUPolicy::name(), runMulticoreWith<LRUPolicy>, BasicHierarchy<LRUPolicy>::supports},
+    {TreePLRUPolicy::name(), runMulticoreWith<TreePLRUPolicy>, BasicHierarchy<TreePLRUPolicy>::supports},
+    {SRRIPPolicy::name(), runMulticoreWith<SRRIPPolicy>, BasicHierarchy<SRRIPPolicy>::supports},
+    {BRRIPPolicy::name(), runMulticoreWith<BRRIPPolicy>, BasicHierarchy<BRRIPPolicy>::supports},
+    {RandomPolicy::name(), runMulticoreWith<RandomPolicy>, BasicHierarchy<RandomPolicy>::supports},
+};
+
+inline int runMulticore(int argc, char *argv[]) {
+    std::string policyName = "lru";
+    uint64_t epochLength = MULTICORE_DEFAULT_EPOCH;
+    int nthreads = std::thread::hardware_concurrency();
+    std::vector<std::string> args;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--policy" && i + 1 < argc) policyName = argv[++i];
+        else if (arg == "--epoch" && i + 1 < argc) epochLength = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "-j" && i + 1 < argc) nthreads = atoi(argv[++i]);
+        else args.push_back(arg);
+    }
+    if (args.size() < 7 || epochLength == 0) {
+        std::cerr << "Usage: " << argv[0] << " --multicore [--policy P] [--epoch N] [-j threads] <L1_SIZE> <L1_ASSOC>"
+                     " <L1_BLOCKSIZE> <VC_NUM_BLOCKS> <L2_SIZE> <L2_ASSOC> <trace_core0> [<trace_core1> ...]\n";
+        return EXIT_FAILURE;
+    }
+    CacheConfig cfg = {atoi(args[0].c_str()), atoi(args[1].c_str()), atoi(args[2].c_str()),
+                       atoi(args[3].c_str()), atoi(args[4].c_str()), atoi(args[5].c_str())};
+    std::vector<std::string> traceFiles(args.begin() + 6, args.end());
+    if (!cfg.valid()) {
+        std::cerr << "Cache sizes must divide into whole sets\n";
+        return EXIT_FAILURE;
+    }
+
+    for (const MulticorePolicy &p : multicorePolicies) {
+        if (policyName != p.name) continue;
+        if (!p.supports(cfg)) {
+            std::cerr << "Replacement policy " << policyName << " does not support this associativity\n";
+            return EXIT_FAILURE;
+        }
+        std::cout << "===== Simulator configuration =====\n";
+        std::cout << "L1_SIZE:\t\t" << cfg.L1_SIZE << "\n";
+        std::cout << "L1_ASSOC:\t\t" << cfg.L1_ASSOC << "\n";
+        std::cout << "L1_BLOCKSIZE:\t\t" << cfg.L1_BLOCKSIZE << "\n";
+        std::cout << "VC_NUM_BLOCKS:\t\t" << cfg.VC_NUM_BLOCKS << "\n";
+        std::cout << "L2_SIZE:\t\t" << cfg.L2_SIZE << "\n";
+        std::cout << "L2_ASSOC:\t\t" << cfg.L2_ASSOC << "\n";
+        std::cout << "cores:\t\t\t" << traceFiles.size() << "\n";
+        std::cout << "epoch:\t\t\t" << epochLength << "\n";
+        return p.run(cfg, traceFiles, epochLength, nthreads);
+    }
+    std::cerr << "Unknown replacement policy: " << policyName << "\n";
+    return EXIT_FAILURE;
+}
+
+#endif
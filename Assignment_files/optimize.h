@@ -0,0 +1,227 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include <algorithm>
+#include <cfloat>
+#include <set>
+#include <unordered_set>
+#include "sweep.h"
+#include "perfmodel.h"
+
+///////////////////////////////////////////////////////////////////////////
+// Design-space optimizer (cache_sim --optimize)
+//
+//    Searches a sweep grid (see sweep.h) for the Pareto front of average
+//    access time, energy-delay product and area (see perfmodel.h), under
+//    an optional area budget (mm^2) and energy budget (nJ over the
+//    trace).
+//
+//    CACTI runs first, for every level of every config, concurrently.
+//    Area is then exact and a config over the area budget is never
+//    simulated. Neither is one whose lower bound (only the trace's cold
+//    misses miss, see performanceLowerBound) is over the energy budget,
+//    or is already dominated by a simulated config: no outcome of its
+//    simulation could put it on the front.
+//
+//    The rest is simulated in waves of OPTIMIZE_WAVE configs per thread,
+//    smallest area first, so the cheap configs that do most of the
+//    dominating are known before the big ones come up. Each wave runs in
+//    parallel over the trace, streamed again for it (runSweepConfigs)
+//    rather than held in memory, and the front is updated before the
+//    next wave is pruned against it.
+///////////////////////////////////////////////////////////////////////////
+
+#define OPTIMIZE_WAVE 2
+
+struct DesignPoint {
+    CacheConfig config;
+    Performance perf;
+    double l1MissRate, l2MissRate;
+};
+
+// One pass over the trace: its length, and per block size of the grid
+// the distinct blocks it touches (its cold misses). Returns false, with
+// the reason printed, if the trace can't be read.
+inline bool traceFootprint(const std::string &path, const std::vector<CacheConfig> &configs, long &numAccesses,
+                           std::map<int, long> &cold) {
+    std::vector<std::pair<int, std::unordered_set<unsigned long> > > blocks;
+    for (const CacheConfig &c : configs) {
+        bool known = false;
+        for (const auto &b : blocks) known |= b.first == c.L1_BLOCKSIZE;
+        if (!known) blocks.emplace_back(c.L1_BLOCKSIZE, std::unordered_set<unsigned long>());
+    }
+    numAccesses = 0;
+    bool ok = forEachTraceAccess(path, [&](char, unsigned long address) {
+        numAccesses++;
+        for (auto &b : blocks) b.second.insert(address / b.first);
+    });
+    for (const auto &b : blocks) cold[b.first] = b.second.size();
+    return ok;
+}
+
+// a is no worse than b in every objective
+inline bool weaklyDominates(const Performance &a, const Performance &b) {
+    return a.aat <= b.aat && a.edp <= b.edp && a.area <= b.area;
+}
+
+// Add p to the front unless a point on it already dominates p; drop the
+// points p dominates
+inline void addToFront(std::vector<DesignPoint> &front, const DesignPoint &p) {
+    for (const DesignPoint &q : front) {
+        if (weaklyDominates(q.perf, p.perf)) return;
+    }
+    std::vector<DesignPoint> kept;
+    for (const DesignPoint &q : front) {
+        if (!weaklyDominates(p.perf, q.perf)) kept.push_back(q);
+    }
+    kept.push_back(p);
+    front.swap(kept);
+}
+
+inline void printDesignPoint(std::ostream &out, const DesignPoint &p, bool json) {
+    const CacheConfig &c = p.config;
+    out << std::fixed << std::setprecision(4);
+    if (json) {
+        out << "{\"L1_SIZE\":" << c.L1_SIZE << ",\"L1_ASSOC\":" << c.L1_ASSOC
+            << ",\"L1_BLOCKSIZE\":" << c.L1_BLOCKSIZE << ",\"VC_NUM_BLOCKS\":" << c.VC_NUM_BLOCKS
+            << ",\"L2_SIZE\":" << c.L2_SIZE << ",\"L2_ASSOC\":" << c.L2_ASSOC
+            << ",\"l1_vc_miss_rate\":" << p.l1MissRate << ",\"l2_miss_rate\":" << p.l2MissRate
+            << ",\"average_access_time\":" << p.perf.aat << ",\"energy\":" << p.perf.energy
+            << ",\"energy_delay_product\":" << p.perf.edp << ",\"area\":" << p.perf.area << "}\n";
+    } else {
+        out << c.L1_SIZE << "," << c.L1_ASSOC << "," << c.L1_BLOCKSIZE << "," << c.VC_NUM_BLOCKS << ","
+            << c.L2_SIZE << "," << c.L2_ASSOC << "," << p.l1MissRate << "," << p.l2MissRate << ","
+            << p.perf.aat << "," << p.perf.energy << "," << p.perf.edp << "," << p.perf.area << "\n";
+    }
+}
+
+// cache_sim --optimize <grid_file> <trace_file> [--max-area A] [--max-energy E] [--json] [--policy P] [-j N]
+inline int runOptimize(int argc, char *argv[]) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " --optimize <grid_file> <trace_file> [--max-area MM2] [--max-energy NJ]"
+                     " [--json] [--policy P] [-j threads]\n";
+        return EXIT_FAILURE;
+    }
+    std::string grid_file = argv[2], trace_file = argv[3];
+    double maxArea = DBL_MAX, maxEnergy = DBL_MAX;
+    bool json = false;
+    std::string policyName = "lru";
+    int nthreads = std::thread::hardware_concurrency();
+    for (int i = 4; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--max-area" && i + 1 < argc) maxArea = atof(argv[++i]);
+        else if (arg == "--max-energy" && i + 1 < argc) maxEnergy = atof(argv[++i]);
+        else if (arg == "--json") json = true;
+        else if (arg == "--policy" && i + 1 < argc) policyName = argv[++i];
+        else if (arg == "-j" && i + 1 < argc) nthreads = atoi(argv[++i]);
+        else {
+            std::cerr << "Unknown optimize option: " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (nthreads < 1) nthreads = 1;
+
+    const SweepPolicy *policy = nullptr;
+    for (const SweepPolicy &p : sweepPolicies) {
+        if (policyName == p.name) policy = &p;
+    }
+    if (!policy) {
+        std::cerr << "Unknown replacement policy: " << policyName << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<CacheConfig> configs;
+    if (!parseSweepGrid(grid_file, configs)) {
+        std::cerr << "Error reading sweep grid: " << grid_file << "\n";
+        return EXIT_FAILURE;
+    }
+    keepSupportedConfigs(*policy, configs);
+    for (const CacheConfig &c : configs) {
+        if (!traceSupportsBlockSize(trace_file, c.L1_BLOCKSIZE)) return EXIT_FAILURE;
+    }
+
+    // CACTI runs in other processes, so it overlaps the pass over the
+    // trace for the lower bounds' cold misses
+    CactiTable table;
+    std::vector<CactiConfig> cactiConfigs;
+    for (const CacheConfig &c : configs) hierarchyCactiConfigs(c, cactiConfigs);
+    std::thread cactiPrefetch([&table, &cactiConfigs, nthreads]() { table.prefetch(cactiConfigs, nthreads); });
+    long numAccesses;
+    std::map<int, long> cold; // per block size
+    bool loaded = traceFootprint(trace_file, configs, numAccesses, cold);
+    cactiPrefetch.join();
+    if (!loaded) return EXIT_FAILURE;
+
+    // Budgets on what is known before simulating
+    struct Candidate {
+        CacheConfig config;
+        HierarchyCost cost;
+        Performance bound;
+    };
+    std::vector<Candidate> candidates;
+    std::set<std::string> errors;
+    long overBudget = 0, failed = 0;
+    for (const CacheConfig &c : configs) {
+        Candidate cand;
+        cand.config = c;
+        std::string error;
+        if (!lookupHierarchyCost(table, c, cand.cost, error)) {
+            if (errors.insert(error).second) std::cerr << error << "; skipping its configurations\n";
+            failed++;
+            continue;
+        }
+        cand.bound = performanceLowerBound(c, cand.cost, numAccesses, cold[c.L1_BLOCKSIZE]);
+        if (cand.bound.area > maxArea || cand.bound.energy > maxEnergy) overBudget++;
+        else candidates.push_back(cand);
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+        return a.bound.area < b.bound.area;
+    });
+
+    std::vector<DesignPoint> front;
+    long pruned = 0, simulated = 0;
+    size_t waveSize = (size_t)nthreads * OPTIMIZE_WAVE;
+    for (size_t next = 0; next < candidates.size();) {
+        std::vector<const Candidate *> wave;
+        std::vector<CacheConfig> waveConfigs;
+        for (; next < candidates.size() && wave.size() < waveSize; ++next) {
+            const Candidate &cand = candidates[next];
+            bool dominated = false;
+            for (const DesignPoint &q : front) dominated |= weaklyDominates(q.perf, cand.bound);
+            if (dominated) {
+                pruned++;
+                continue;
+            }
+            wave.push_back(&cand);
+            waveConfigs.push_back(cand.config);
+        }
+        if (wave.empty()) continue;
+        std::vector<SimStats> results;
+        if (!policy->run(waveConfigs, trace_file, nthreads, results)) return EXIT_FAILURE;
+        simulated += wave.size();
+        for (size_t i = 0; i < wave.size(); ++i) {
+            DesignPoint p;
+            p.config = wave[i]->config;
+            p.perf = evaluatePerformance(p.config, results[i], wave[i]->cost);
+            p.l1MissRate = results[i].l1MissRate();
+            p.l2MissRate = results[i].l2MissRate();
+            if (p.perf.energy > maxEnergy) overBudget++;
+            else addToFront(front, p);
+        }
+    }
+
+    std::sort(front.begin(), front.end(), [](const DesignPoint &a, const DesignPoint &b) {
+        return a.perf.area < b.perf.area || (a.perf.area == b.perf.area && a.perf.aat < b.perf.aat);
+    });
+    if (!json) {
+        std::cout << "L1_SIZE,L1_ASSOC,L1_BLOCKSIZE,VC_NUM_BLOCKS,L2_SIZE,L2_ASSOC,l1_vc_miss_rate,l2_miss_rate,"
+                     "average_access_time,energy,energy_delay_product,area\n";
+    }
+    for (const DesignPoint &p : front) printDesignPoint(std::cout, p, json);
+    std::cerr << configs.size() << " configurations: " << failed << " without CACTI results, " << overBudget
+              << " over budget, " << pruned << " pruned as dominated, " << simulated << " simulated, "
+              << front.size() << " on the Pareto front\n";
+    return 0;
+}
+
+#endif
@@ -1,5 +1,9 @@
+#ifndef PARSE_H
+#define PARSE_H
+
 #include <assert.h>
 #include <cstring>
+#include <cstdio>
 
 ///////////////////////////////////////////////////////////////////////////
 // If return value is >0, CACTI failed on this cache configuration.
@@ -71,3 +75,123 @@ int get_cacti_results(unsigned int SIZE, unsigned int BLOCKSIZE, unsigned int AS
 
 	return(errflag);
 }
+
+///////////////////////////////////////////////////////////////////////////
+// Memoized CACTI lookups
+//
+//    A CACTI run costs more than simulating a whole trace, and sweeps ask
+//    for the same (SIZE, BLOCKSIZE, ASSOC) over and over. CactiTable keeps
+//    every result in an in-process hash map and appends it to a text table
+//    on disk, one line per config:
+//
+//       SIZE BLOCKSIZE ASSOC TECH errflag AccessTime Energy Area
+//
+//    so later runs never invoke CACTI for a config seen before. Failed
+//    configs (errflag > 0) are remembered as well.
+///////////////////////////////////////////////////////////////////////////
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+#define CACTI_TECH_NODE "45nm"
+#define CACTI_TABLE_FILE "cacti_table.txt"
+
+struct CactiResult {
+	int errflag;
+	float AccessTime, Energy, Area;
+};
+
+struct CactiConfig {
+	unsigned int SIZE, BLOCKSIZE, ASSOC;
+};
+
+class CactiTable {
+private:
+	std::string path;
+	std::unordered_map<std::string, CactiResult> results;
+	std::mutex lock;
+
+	static std::string key(unsigned int SIZE, unsigned int BLOCKSIZE, unsigned int ASSOC) {
+		char buffer[96];
+		sprintf(buffer, "%u %u %u %s", SIZE, BLOCKSIZE, ASSOC, CACTI_TECH_NODE);
+		return buffer;
+	}
+
+	// Caller holds lock. 9 significant digits round-trip a float, so a
+	// result reloaded from disk is exactly the one CACTI returned.
+	void store(const std::string &k, const CactiResult &r) {
+		results[k] = r;
+		FILE *out = fopen(path.c_str(), "a");
+		if (!out) return;
+		fprintf(out, "%s %d %.9g %.9g %.9g\n", k.c_str(), r.errflag, r.AccessTime, r.Energy, r.Area);
+		fclose(out);
+	}
+
+public:
+	CactiTable(const std::string &tablePath = CACTI_TABLE_FILE) : path(tablePath) {
+		FILE *in = fopen(path.c_str(), "r");
+		if (!in) return;
+		char tech[32];
+		unsigned int SIZE, BLOCKSIZE, ASSOC;
+		CactiResult r;
+		while (fscanf(in, "%u %u %u %31s %d %g %g %g", &SIZE, &BLOCKSIZE, &ASSOC, tech,
+		              &r.errflag, &r.AccessTime, &r.Energy, &r.Area) == 8) {
+			if (strcmp(tech, CACTI_TECH_NODE) == 0) results[key(SIZE, BLOCKSIZE, ASSOC)] = r;
+		}
+		fclose(in);
+	}
+
+	bool contains(unsigned int SIZE, unsigned int BLOCKSIZE, unsigned int ASSOC) {
+		std::lock_guard<std::mutex> guard(lock);
+		return results.count(key(SIZE, BLOCKSIZE, ASSOC)) > 0;
+	}
+
+	// Same contract as get_cacti_results, but only runs CACTI on a miss
+	int lookup(unsigned int SIZE, unsigned int BLOCKSIZE, unsigned int ASSOC, float *AccessTime, float *Energy, float *Area) {
+		std::string k = key(SIZE, BLOCKSIZE, ASSOC);
+		CactiResult r;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			auto it = results.find(k);
+			if (it != results.end()) r = it->second;
+			else r.errflag = -1;
+		}
+		if (r.errflag < 0) {
+			r.AccessTime = r.Energy = r.Area = 0;
+			r.errflag = get_cacti_results(SIZE, BLOCKSIZE, ASSOC, &r.AccessTime, &r.Energy, &r.Area);
+			std::lock_guard<std::mutex> guard(lock);
+			if (!results.count(k)) store(k, r);
+		}
+		*AccessTime = r.AccessTime;
+		*Energy = r.Energy;
+		*Area = r.Area;
+		return r.errflag;
+	}
+
+	// Run CACTI for every config not yet in the table, nthreads at a time
+	void prefetch(const std::vector<CactiConfig> &configs, int nthreads) {
+		std::vector<CactiConfig> missing;
+		for (const CactiConfig &c : configs) {
+			if (!contains(c.SIZE, c.BLOCKSIZE, c.ASSOC)) missing.push_back(c);
+		}
+		if (missing.empty()) return;
+		if (nthreads < 1) nthreads = 1;
+		std::atomic<size_t> next(0);
+		std::vector<std::thread> workers;
+		for (int t = 0; t < nthreads && t < (int)missing.size(); ++t) {
+			workers.emplace_back([&]() {
+				float AccessTime, Energy, Area;
+				for (size_t i = next++; i < missing.size(); i = next++) {
+					lookup(missing[i].SIZE, missing[i].BLOCKSIZE, missing[i].ASSOC, &AccessTime, &Energy, &Area);
+				}
+			});
+		}
+		for (std::thread &w : workers) w.join();
+	}
+};
+
+#endif
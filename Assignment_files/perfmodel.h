@@ -0,0 +1,111 @@
+#ifndef PERFMODEL_H
+#define PERFMODEL_H
+
+#include <string>
+#include <vector>
+#include "parse.h"
+#include "hierarchy.h"
+
+///////////////////////////////////////////////////////////////////////////
+// Performance model: average access time, energy-delay product and area
+//
+//    Every level's hit time, energy per access and area come from CACTI
+//    (through the memoized CactiTable). The VC is modelled as a fully
+//    associative cache of VC_NUM_BLOCKS blocks. Main memory costs
+//    MEMORY_LATENCY_NS plus the block transfer at
+//    MEMORY_BANDWIDTH_BYTES_PER_NS per miss, and MEMORY_ENERGY_NJ per
+//    block moved.
+//
+//       AAT    = HT_L1 + SRR * HT_VC + MR_L1+VC * (HT_L2 + MR_L2 * MP)
+//                (MR_L1+VC * MP without an L2)
+//       energy = (L1 accesses + L1 misses) * E_L1 + 2 * swap requests * E_VC
+//              + (L2 accesses + L2 misses) * E_L2 + memory traffic * E_MEM
+//       EDP    = energy * L1 accesses * AAT
+//       area   = A_L1 + A_VC + A_L2
+//
+//    Times are in ns, energies in nJ and areas in mm^2.
+///////////////////////////////////////////////////////////////////////////
+
+#define MEMORY_LATENCY_NS 20.0
+#define MEMORY_BANDWIDTH_BYTES_PER_NS 16.0
+#define MEMORY_ENERGY_NJ 0.05
+
+// CACTI results of one level, all zero for a level that doesn't exist
+struct LevelCost {
+    float accessTime, energy, area;
+};
+
+struct HierarchyCost {
+    LevelCost l1, vc, l2;
+};
+
+struct Performance {
+    double aat, energy, edp, area;
+};
+
+// The CACTI configs the levels of cfg need
+inline void hierarchyCactiConfigs(const CacheConfig &cfg, std::vector<CactiConfig> &out) {
+    out.push_back(CactiConfig{(unsigned)cfg.L1_SIZE, (unsigned)cfg.L1_BLOCKSIZE, (unsigned)cfg.L1_ASSOC});
+    if (cfg.VC_NUM_BLOCKS > 0) {
+        out.push_back(CactiConfig{(unsigned)(cfg.VC_NUM_BLOCKS * cfg.L1_BLOCKSIZE), (unsigned)cfg.L1_BLOCKSIZE,
+                                  (unsigned)cfg.VC_NUM_BLOCKS});
+    }
+    if (cfg.L2_SIZE > 0) {
+        out.push_back(CactiConfig{(unsigned)cfg.L2_SIZE, (unsigned)cfg.L1_BLOCKSIZE, (unsigned)cfg.L2_ASSOC});
+    }
+}
+
+// CACTI numbers of every level of cfg. Returns false, naming the level
+// CACTI failed on in error, if any lookup failed.
+inline bool lookupHierarchyCost(CactiTable &table, const CacheConfig &cfg, HierarchyCost &cost, std::string &error) {
+    cost = HierarchyCost{{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+    std::vector<CactiConfig> configs;
+    hierarchyCactiConfigs(cfg, configs);
+    LevelCost *levels[3] = {&cost.l1, cfg.VC_NUM_BLOCKS > 0 ? &cost.vc : &cost.l2, &cost.l2};
+    const char *names[3] = {"L1", cfg.VC_NUM_BLOCKS > 0 ? "VC" : "L2", "L2"};
+    for (size_t i = 0; i < configs.size(); ++i) {
+        const CactiConfig &c = configs[i];
+        LevelCost &l = *levels[i];
+        if (table.lookup(c.SIZE, c.BLOCKSIZE, c.ASSOC, &l.accessTime, &l.energy, &l.area) > 0) {
+            error = std::string("CACTI failed for ") + names[i] + " config " + std::to_string(c.SIZE) + "/" +
+                    std::to_string(c.BLOCKSIZE) + "/" + std::to_string(c.ASSOC);
+            return false;
+        }
+    }
+    return true;
+}
+
+inline double memoryMissPenalty(const CacheConfig &cfg) {
+    return MEMORY_LATENCY_NS + cfg.L1_BLOCKSIZE / MEMORY_BANDWIDTH_BYTES_PER_NS;
+}
+
+inline Performance evaluatePerformance(const CacheConfig &cfg, const SimStats &s, const HierarchyCost &c) {
+    double accesses = s.l1Reads + s.l1Writes;
+    double penalty = memoryMissPenalty(cfg);
+    double below = cfg.L2_SIZE > 0 ? c.l2.accessTime + s.l2MissRate() * penalty : penalty;
+    Performance p;
+    p.aat = c.l1.accessTime + s.swapRequestRate() * c.vc.accessTime + s.l1MissRate() * below;
+    p.energy = (accesses + s.l1ReadMisses + s.l1WriteMisses) * c.l1.energy + 2.0 * s.swapRequests * c.vc.energy +
+               (double)(s.l2Reads + s.l2Writes + s.l2ReadMisses + s.l2WriteMisses) * c.l2.energy +
+               s.memoryTraffic() * MEMORY_ENERGY_NJ;
+    p.edp = p.energy * accesses * p.aat;
+    p.area = c.l1.area + c.vc.area + c.l2.area;
+    return p;
+}
+
+// What any simulation of `accesses` accesses with `coldMisses` distinct
+// blocks can at best achieve: only the first touch of a block misses L1
+// (and L2), nothing is swapped and nothing is written back. Area is exact.
+inline Performance performanceLowerBound(const CacheConfig &cfg, const HierarchyCost &c, long accesses,
+                                         long coldMisses) {
+    double cold = accesses > 0 ? (double)coldMisses / accesses : 0;
+    double penalty = memoryMissPenalty(cfg);
+    Performance p;
+    p.aat = c.l1.accessTime + cold * (cfg.L2_SIZE > 0 ? c.l2.accessTime + penalty : penalty);
+    p.energy = (double)(accesses + coldMisses) * c.l1.energy + 2.0 * coldMisses * c.l2.energy;
+    p.edp = p.energy * accesses * p.aat;
+    p.area = c.l1.area + c.vc.area + c.l2.area;
+    return p;
+}
+
+#endif
@@ -0,0 +1,342 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "trace.h"
+#include "profile.h"
+
+///////////////////////////////////////////////////////////////////////////
+// Pipelined text trace decoding
+//
+//    A producer thread reads the trace in large chunks (from a "gzip -dc"
+//    child process for .gz files), decodes the lines into Access records and publishes
+//    them in fixed-size batches through a single-producer/single-consumer
+//    lock-free ring. The simulation thread consumes the batches in place,
+//    so file I/O and parsing overlap with simulation.
+///////////////////////////////////////////////////////////////////////////
+
+#define PIPELINE_BATCH 4096      // accesses per batch
+#define PIPELINE_SLOTS 16        // batches in flight, power of two
+#define PIPELINE_CHUNK (1 << 20) // bytes read per fread
+
+struct AccessBatch {
+    Access records[PIPELINE_BATCH];
+    size_t count;
+};
+
+// Bounded SPSC ring of preallocated slots. The producer fills the slot
+// returned by acquire() and publishes it with push(); the consumer reads
+// the slot returned by front() and hands it back with pop(). head and
+// tail sit on separate cache lines so the two threads don't false-share.
+template <class T, size_t N>
+class SpscRing {
+private:
+    static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+    std::vector<T> slots; // on the heap, a ring of batches is ~1MB
+    alignas(64) std::atomic<size_t> head; // next slot to consume
+    alignas(64) std::atomic<size_t> tail; // next slot to produce
+
+public:
+    SpscRing() : slots(N), head(0), tail(0) {}
+
+    // Producer side: slot to fill, or nullptr if the ring is full
+    T *acquire() {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N) return nullptr;
+        return &slots[t & (N - 1)];
+    }
+    void push() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Consumer side: oldest published slot, or nullptr if the ring is empty
+    T *front() {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return nullptr;
+        return &slots[h & (N - 1)];
+    }
+    void pop() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+};
+
+class TracePipeline {
+private:
+    SpscRing<AccessBatch, PIPELINE_SLOTS> ring;
+    std::thread producer;
+    std::atomic<bool> done;
+    std::string error;
+    FILE *in;
+    pid_t gzip; // decompressor feeding in, or -1
+
+    // Run "gzip -dc -- path" without a shell, its output on in
+    bool spawnGzip(const std::string &path) {
+        int fds[2];
+        if (pipe(fds) != 0) return false;
+        const char *argv[] = {"gzip", "-dc", "--", path.c_str(), nullptr};
+        gzip = fork();
+        if (gzip == 0) {
+            dup2(fds[1], STDOUT_FILENO);
+            ::close(fds[0]);
+            ::close(fds[1]);
+            execvp(argv[0], (char *const *)argv);
+            _exit(127);
+        }
+        ::close(fds[1]);
+        if (gzip < 0 || !(in = fdopen(fds[0], "r"))) {
+            ::close(fds[0]);
+            if (gzip > 0) waitpid(gzip, nullptr, 0);
+            gzip = -1;
+            return false;
+        }
+        return true;
+    }
+
+    // Wait for gzip once it has closed its output; a failure (missing
+    // gzip, corrupt or truncated file) becomes the trace's error
+    void reapGzip() {
+        int status;
+        if (waitpid(gzip, &status, 0) < 0) status = -1;
+        gzip = -1;
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) return;
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 127) error = "Cannot run gzip";
+        else error = "gzip failed to decompress the trace";
+    }
+
+    // Wait for a free slot; the consumer always drains, so this terminates
+    AccessBatch *nextSlot() {
+        AccessBatch *b;
+        while (!(b = ring.acquire())) std::this_thread::yield();
+        b->count = 0;
+        return b;
+    }
+
+    void produce() {
+        std::vector<char> buffer(PIPELINE_CHUNK + 1);
+        size_t carry = 0;
+        AccessBatch *batch = nextSlot();
+        for (;;) {
+            size_t n = fread(&buffer[carry], 1, PIPELINE_CHUNK - carry, in);
+            size_t len = carry + n;
+            bool eof = n == 0;
+            if (eof && len == 0) break;
+            if (eof) buffer[len++] = '\n'; // last line without a newline
+            buffer[len] = '\0';
+
+            char *p = &buffer[0], *end = &buffer[0] + len;
+            for (;;) {
+                char *nl = (char *)memchr(p, '\n', end - p);
+                if (!nl) break;
+                *nl = '\0';
+                char type;
+                unsigned long address;
+                bool parsed;
+                {
+                    PROFILE_SCOPE(PROFILE_TRACE_PARSE);
+                    parsed = parseTraceLine(p, type, address);
+                }
+                if (parsed) {
+                    PROFILE_COUNT(PROFILE_TRACE_RECORDS);
+                    if (type != 'r' && type != 'w') {
+                        error = std::string("Invalid operation type: ") + type;
+                        goto finish;
+                    }
+                    batch->records[batch->count++] = Access{address, type};
+                    if (batch->count == PIPELINE_BATCH) {
+                        ring.push();
+                        batch = nextSlot();
+                    }
+                } else if (type != '\0' && type != '\r') {
+                    error = "Malformed trace line";
+                    goto finish;
+                }
+                p = nl + 1;
+            }
+            carry = end - p;
+            if (eof) break;
+            if (carry == PIPELINE_CHUNK) {
+                error = "Trace line too long";
+                goto finish;
+            }
+            memmove(&buffer[0], p, carry);
+        }
+        if (gzip > 0) reapGzip();
+    finish:
+        if (batch->count > 0) ring.push();
+        done.store(true, std::memory_order_release);
+    }
+
+public:
+    TracePipeline() : done(false), in(nullptr), gzip(-1) {}
+    ~TracePipeline() { close(); }
+
+    // Start decoding path on the producer thread
+    bool open(const std::string &path) {
+        bool compressed = path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0;
+        if (compressed) {
+            FILE *probe = fopen(path.c_str(), "rb");
+            if (!probe) return false;
+            fclose(probe);
+            if (!spawnGzip(path)) return false;
+        } else {
+            in = fopen(path.c_str(), "r");
+        }
+        if (!in) return false;
+        producer = std::thread(&TracePipeline::produce, this);
+        return true;
+    }
+
+    // Next decoded batch, or nullptr once the whole trace has been consumed.
+    // The batch stays valid until release().
+    const AccessBatch *next() {
+        for (;;) {
+            AccessBatch *b = ring.front();
+            if (b) return b;
+            if (done.load(std::memory_order_acquire)) {
+                // Everything published before done is visible now
+                b = ring.front();
+                return b;
+            }
+            std::this_thread::yield();
+        }
+    }
+    void release() { ring.pop(); }
+
+    // Empty if the trace decoded cleanly; valid once next() returned nullptr
+    const std::string &getError() const { return error; }
+
+    void close() {
+        if (producer.joinable()) {
+            // Drain so a producer blocked on a full ring can finish
+            while (next()) release();
+            producer.join();
+        }
+        if (in) {
+            fclose(in);
+            in = nullptr;
+        }
+        // Stopped before the end of a .gz trace: gzip exits on the closed
+        // pipe, and its status no longer matters
+        if (gzip > 0) {
+            waitpid(gzip, nullptr, 0);
+            gzip = -1;
+        }
+    }
+
+    // Call f(records, n) for consecutive runs of accesses [first, end) of
+    // the trace, straight out of the ring; returns false on a decode error
+    template <class F>
+    bool forEachBatch(F f, uint64_t first = 0, uint64_t end = UINT64_MAX) {
+        uint64_t position = 0;
+        while (const AccessBatch *b = next()) {
+            if (position + b->count > first) {
+                size_t i = position < first ? first - position : 0;
+                size_t n = end - position < b->count ? end - position : b->count;
+                if (i < n) f(b->records + i, n - i);
+            }
+            position += b->count;
+            release();
+            if (position >= end) break;
+        }
+        return error.empty();
+    }
+
+    // Call f(type, address) for accesses [first, end) of the trace;
+    // returns false on a decode error
+    template <class F>
+    bool forEach(F f, uint64_t first = 0, uint64_t end = UINT64_MAX) {
+        return forEachBatch([&](const Access *records, size_t n) {
+            for (size_t i = 0; i < n; ++i) f(records[i].type, records[i].address);
+        }, first, end);
+    }
+};
+
+// Call f(type, address) for every access of a binary, text or .gz trace,
+// or only for accesses [first, end). On failure prints the reason to
+// stderr and returns false.
+template <class F>
+bool forEachTraceAccess(const std::string &path, F f, uint64_t first = 0, uint64_t end = UINT64_MAX) {
+    if (isBinaryTrace(path.c_str())) {
+        MappedTrace mapped;
+        if (!mapped.open(path.c_str())) {
+            std::cerr << "Error opening trace file: " << path << "\n";
+            return false;
+        }
+        mapped.forEach(f, first, end);
+        return true;
+    }
+    TracePipeline trace;
+    if (!trace.open(path)) {
+        std::cerr << "Error opening trace file: " << path << "\n";
+        return false;
+    }
+    if (!trace.forEach(f, first, end)) {
+        std::cerr << trace.getError() << "\n";
+        return false;
+    }
+    return true;
+}
+
+// A trace compacted at block size B (see TRACE_COMPACT) only replays
+// faithfully with block sizes that are multiples of B. Prints why not
+// and returns false otherwise.
+inline bool traceSupportsBlockSize(const std::string &path, int blockSize) {
+    uint32_t compact = traceCompactBlockSize(path.c_str());
+    if (compact == 0 || (blockSize > 0 && blockSize % compact == 0)) return true;
+    std::cerr << "Trace " << path << " is compacted at block size " << compact
+              << "; block size " << blockSize << " is not a multiple of it\n";
+    return false;
+}
+
+// forEachTraceAccess handing f(records, n) runs of up to PIPELINE_BATCH
+// accesses instead, for the batched cache entry point (handleBatch).
+// Binary trace records are decoded into a local buffer first.
+template <class F>
+bool forEachTraceBatch(const std::string &path, F f, uint64_t first = 0, uint64_t end = UINT64_MAX) {
+    if (isBinaryTrace(path.c_str())) {
+        MappedTrace mapped;
+        if (!mapped.open(path.c_str())) {
+            std::cerr << "Error opening trace file: " << path << "\n";
+            return false;
+        }
+        std::vector<Access> buffer(PIPELINE_BATCH);
+        size_t count = 0;
+        mapped.forEach([&](char type, unsigned long address) {
+            buffer[count++] = Access{address, type};
+            if (count == PIPELINE_BATCH) {
+                f(buffer.data(), count);
+                count = 0;
+            }
+        }, first, end);
+        if (count) f(buffer.data(), count);
+        return true;
+    }
+    TracePipeline trace;
+    if (!trace.open(path)) {
+        std::cerr << "Error opening trace file: " << path << "\n";
+        return false;
+    }
+    if (!trace.forEachBatch(f, first, end)) {
+        std::cerr << trace.getError() << "\n";
+        return false;
+    }
+    return true;
+}
+
+// forEachTraceBatch, except that a compacted binary trace (see
+// TRACE_COMPACT) goes to run(address, ops, repeat) a run at a time
+template <class F, class R>
+bool forEachTraceRun(const std::string &path, F f, R run, uint64_t first = 0, uint64_t end = UINT64_MAX) {
+    if (traceCompactBlockSize(path.c_str()) == 0) return forEachTraceBatch(path, f, first, end);
+    MappedTrace mapped;
+    if (!mapped.open(path.c_str())) {
+        std::cerr << "Error opening trace file: " << path << "\n";
+        return false;
+    }
+    mapped.forEachRun(run, first, end);
+    return true;
+}
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////
+// Hardware prefetcher models (cache_sim --prefetch LEVEL:KIND[:DEGREE])
+//
+//    A Prefetcher attaches to any cache level (CacheLevel::setPrefetcher)
+//    and is trained on the level's demand accesses. Only misses and first
+//    uses of prefetched blocks train it, so the hits it causes keep a
+//    stream going without every hit retraining it. It returns candidate
+//    blocks. The level fetches each one it does not already hold from
+//    the next level, and fills it marked BLOCK_PREFETCHED.
+//
+//       next-line  on a trigger, the next DEGREE blocks
+//       stride     one global address-delta detector (no PC): once the
+//                  same block delta is seen twice in a row, DEGREE
+//                  blocks ahead along it
+//       stream     PREFETCH_STREAMS trackers, each following the
+//                  triggers within PREFETCH_STREAM_WINDOW blocks of
+//                  its last one; a tracker that moved the same way
+//                  twice runs DEGREE blocks ahead in that direction
+//
+//    Statistics, per level:
+//
+//       issued     prefetch fills, i.e. requests to the next level
+//       useful     prefetched blocks demanded before leaving the sets;
+//                  each replaces a demand fetch, so the extra traffic
+//                  to the next level is issued - useful
+//       late       useful ones demanded within PREFETCH_LATENCY demand
+//                  accesses of the prefetch, before it would have arrived
+//       polluting  demand misses on blocks a prefetch fill evicted,
+//                  caught by a direct-mapped filter of evicted tags
+///////////////////////////////////////////////////////////////////////////
+
+#define PREFETCH_MAX_DEGREE 16
+#define PREFETCH_DEFAULT_DEGREE 2
+#define PREFETCH_STREAMS 16
+#define PREFETCH_STREAM_WINDOW 16
+#define PREFETCH_LATENCY 16      // demand accesses of the level a prefetch takes
+#define PREFETCH_IN_FLIGHT 64    // recent prefetches remembered for lateness
+#define PREFETCH_FILTER 4096     // pollution filter entries, power of two
+
+struct PrefetchStats {
+    long issued;
+    long useful;
+    long late;
+    long polluting;
+};
+
+class Prefetcher {
+private:
+    struct InFlight {
+        unsigned long block;
+        unsigned long issuedAt;
+    };
+    InFlight inFlight[PREFETCH_IN_FLIGHT]; // ring of the latest prefetches
+    int inFlightNext;
+    std::vector<unsigned long> filter;     // block + 1 of prefetch victims, 0 = empty
+
+    static size_t filterSlot(unsigned long block) { return (block * 0x9E3779B97F4A7C15ULL >> 40) & (PREFETCH_FILTER - 1); }
+
+protected:
+    int degree;
+
+    // Blocks to prefetch after a trigger on block; at most degree
+    virtual int train(unsigned long block, unsigned long *out) = 0;
+
+    // block + step, block + 2 * step, ... into out, at most degree of
+    // them, stopping before one would wrap around the block numbers (a
+    // descending stream near block 0, say); returns how many
+    int stepFrom(unsigned long block, long step, unsigned long *out) const {
+        int n = 0;
+        for (; n < degree; ++n) {
+            if (step < 0 ? 0UL - (unsigned long)step > block : (unsigned long)step > ~0UL - block) break;
+            block += step;
+            out[n] = block;
+        }
+        return n;
+    }
+
+public:
+    PrefetchStats stats;
+
+    explicit Prefetcher(int degree)
+        : inFlightNext(0), filter(PREFETCH_FILTER, 0), degree(degree), stats{0, 0, 0, 0} {
+        for (InFlight &f : inFlight) f = InFlight{0, 0};
+        if (this->degree < 1) this->degree = 1;
+        if (this->degree > PREFETCH_MAX_DEGREE) this->degree = PREFETCH_MAX_DEGREE;
+    }
+    virtual ~Prefetcher() {}
+    virtual const char *name() const = 0;
+    int getDegree() const { return degree; }
+
+    // A demand access of block at time now (the level's demand access
+    // count). prefetched is true on the first use of a prefetched block.
+    // Returns the number of candidates written to out.
+    int demand(unsigned long block, bool hit, bool prefetched, unsigned long now, unsigned long *out) {
+        if (hit && prefetched) {
+            stats.useful++;
+            for (const InFlight &f : inFlight) {
+                if (f.block == block && f.issuedAt + PREFETCH_LATENCY > now && f.issuedAt <= now) {
+                    stats.late++;
+                    break;
+                }
+            }
+        }
+        if (!hit) {
+            unsigned long &slot = filter[filterSlot(block)];
+            if (slot == block + 1) {
+                stats.polluting++;
+                slot = 0;
+            }
+        }
+        if (hit && !prefetched) return 0;
+        return train(block, out);
+    }
+
+    // A prefetch of block was filled at time now, evicting victim if
+    // evictedValid
+    void filled(unsigned long block, unsigned long now, bool evictedValid, unsigned long victim) {
+        stats.issued++;
+        inFlight[inFlightNext] = InFlight{block, now};
+        inFlightNext = (inFlightNext + 1) % PREFETCH_IN_FLIGHT;
+        if (evictedValid) filter[filterSlot(victim)] = victim + 1;
+    }
+};
+
+class NextLinePrefetcher : public Prefetcher {
+protected:
+    int train(unsigned long block, unsigned long *out) {
+        return stepFrom(block, 1, out);
+    }
+
+public:
+    explicit NextLinePrefetcher(int degree) : Prefetcher(degree) {}
+    const char *name() const { return "next-line"; }
+};
+
+class StridePrefetcher : public Prefetcher {
+private:
+    unsigned long last;
+    long delta;
+    int confidence;
+
+protected:
+    int train(unsigned long block, unsigned long *out) {
+        long d = (long)(block - last);
+        confidence = (d != 0 && d == delta) ? confidence + 1 : 0;
+        delta = d;
+        last = block;
+        if (confidence < 1) return 0;
+        return stepFrom(block, delta, out);
+    }
+
+public:
+    explicit StridePrefetcher(int degree) : Prefetcher(degree), last(0), delta(0), confidence(0) {}
+    const char *name() const { return "stride"; }
+};
+
+class StreamPrefetcher : public Prefetcher {
+private:
+    struct Stream {
+        unsigned long last;
+        int direction; // +1, -1, or 0 until it has moved
+        int confidence;
+        unsigned long lastUse;
+        bool valid;
+    };
+    Stream streams[PREFETCH_STREAMS];
+    unsigned long clock;
+
+protected:
+    int train(unsigned long block, unsigned long *out) {
+        clock++;
+        Stream *s = nullptr;
+        for (Stream &t : streams) {
+            long d = (long)(block - t.last);
+            if (t.valid && d >= -PREFETCH_STREAM_WINDOW && d <= PREFETCH_STREAM_WINDOW) {
+                s = &t;
+                break;
+            }
+        }
+        if (!s) {
+            // Start a new stream in the least recently used tracker
+            s = &streams[0];
+            for (Stream &t : streams) {
+                if (!t.valid || t.lastUse < s->lastUse) s = &t;
+                if (!t.valid) break;
+            }
+            *s = Stream{block, 0, 0, clock, true};
+            return 0;
+        }
+        long d = (long)(block - s->last);
+        int direction = d > 0 ? 1 : (d < 0 ? -1 : 0);
+        if (direction != 0) {
+            s->confidence = direction == s->direction ? s->confidence + 1 : 0;
+            s->direction = direction;
+            s->last = block;
+        }
+        s->lastUse = clock;
+        if (s->confidence < 1) return 0;
+        return stepFrom(block, s->direction, out);
+    }
+
+public:
+    explicit StreamPrefetcher(int degree) : Prefetcher(degree), clock(0) {
+        for (Stream &t : streams) t = Stream{0, 0, 0, 0, false};
+    }
+    const char *name() const { return "stream"; }
+};
+
+// A prefetcher from "next-line", "stride" or "stream"; nullptr if unknown
+inline Prefetcher *makePrefetcher(const std::string &kind, int degree) {
+    if (kind == "next-line") return new NextLinePrefetcher(degree);
+    if (kind == "stride") return new StridePrefetcher(degree);
+    if (kind == "stream") return new StreamPrefetcher(degree);
+    return nullptr;
+}
+
+#endif
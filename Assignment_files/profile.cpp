@@ -0,0 +1,22 @@
+#include <cstdlib>
+#include <new>
+#include "profile.h"
+
+// Global allocation counting for the per-stage counts of profile.h,
+// linked into cache_sim only with PROFILE=1 (a library or another
+// program keeps its own operator new). All three stay out of line so GCC
+// does not pair the inlined malloc/free with new/delete and warn about a
+// mismatch.
+
+#ifdef CACHE_SIM_PROFILE
+
+__attribute__((noinline)) void *operator new(size_t n) {
+    if (profileThreadData) profileThreadData->allocations++;
+    void *p = malloc(n ? n : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+__attribute__((noinline)) void operator delete(void *p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept { free(p); }
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+///////////////////////////////////////////////////////////////////////////
+// Self-profiling of the simulator hot paths (make PROFILE=1)
+//
+//    Built with -DCACHE_SIM_PROFILE, every PROFILE_SCOPE times its block
+//    with the TSC (steady_clock off x86) and counts calls and heap
+//    allocations made inside it (counted by the operator new of
+//    profile.cpp, which only cache_sim links), PROFILE_COUNT bumps an
+//    event counter, and every cache keeps per-set access and eviction
+//    histograms (PROFILE_SET_*, in CacheLevel members). At
+//    exit everything is written as JSON to $CACHE_SIM_PROFILE_OUT
+//    (default cache_sim_profile.json).
+//
+//    Stage times are inclusive: next_level contains the whole next
+//    level's access when it is called inline. Each thread counts into
+//    its own block, merged at exit.
+//
+//    Without CACHE_SIM_PROFILE all of the macros expand to nothing and
+//    this header defines only the stage and event names.
+///////////////////////////////////////////////////////////////////////////
+
+enum ProfileStage {
+    PROFILE_TRACE_PARSE, // one text trace line
+    PROFILE_DECODE,      // getTag + getIndex
+    PROFILE_SET_LOOKUP,  // tag search of one set
+    PROFILE_VC_SEARCH,   // victim cache lookup
+    PROFILE_NEXT_LEVEL,  // request to the next level
+    PROFILE_EVICTION,    // fill, eviction and VC insert
+    PROFILE_NUM_STAGES
+};
+
+enum ProfileEvent {
+    PROFILE_READS,
+    PROFILE_WRITES,
+    PROFILE_SET_HITS,
+    PROFILE_SET_MISSES,
+    PROFILE_VC_HITS,
+    PROFILE_EVICTIONS,
+    PROFILE_NEXT_LEVEL_REQUESTS,
+    PROFILE_TRACE_RECORDS,
+    PROFILE_REPEAT_HITS, // accesses to a level's last block, not looked up
+    PROFILE_NUM_EVENTS
+};
+
+#ifdef CACHE_SIM_PROFILE
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+inline unsigned long long profileTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static const char *const profileStageNames[PROFILE_NUM_STAGES] = {
+    "trace_parse", "decode", "set_lookup", "vc_search", "next_level", "eviction"};
+static const char *const profileEventNames[PROFILE_NUM_EVENTS] = {
+    "reads", "writes", "set_hits", "set_misses", "vc_hits", "evictions", "next_level_requests", "trace_records",
+    "repeat_hits"};
+
+// Counters of one thread
+struct ProfileThreadData {
+    unsigned long long ticks[PROFILE_NUM_STAGES];
+    unsigned long calls[PROFILE_NUM_STAGES];
+    unsigned long allocs[PROFILE_NUM_STAGES];
+    unsigned long events[PROFILE_NUM_EVENTS];
+    unsigned long allocations; // every allocation on this thread once profiled
+};
+
+// Per-set histograms of one cache
+struct ProfileSets {
+    int size, assoc, blockSize;
+    std::vector<unsigned long> accesses, evictions;
+};
+
+class ProfileRegistry {
+private:
+    std::mutex lock;
+    std::vector<ProfileThreadData *> threads;
+    std::vector<ProfileSets *> caches;
+    unsigned long long startTicks;
+    std::chrono::steady_clock::time_point startTime;
+
+public:
+    ProfileRegistry() : startTicks(profileTicks()), startTime(std::chrono::steady_clock::now()) {}
+    ~ProfileRegistry() { dump(); }
+
+    void add(ProfileThreadData *t) {
+        std::lock_guard<std::mutex> guard(lock);
+        threads.push_back(t);
+    }
+    ProfileSets *addCache(int size, int assoc, int blockSize, int numSets) {
+        ProfileSets *c = new ProfileSets{size, assoc, blockSize, std::vector<unsigned long>(numSets, 0),
+                                         std::vector<unsigned long>(numSets, 0)};
+        std::lock_guard<std::mutex> guard(lock);
+        caches.push_back(c);
+        return c;
+    }
+
+    // Merge all threads and write the JSON report
+    void dump() {
+        const char *env = getenv("CACHE_SIM_PROFILE_OUT");
+        std::string path = env ? env : "cache_sim_profile.json";
+        std::ofstream out(path);
+        if (!out) {
+            std::cerr << "Cannot write profile to " << path << "\n";
+            return;
+        }
+        double wallNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+        double ticksPerNs = wallNs > 0 ? (profileTicks() - startTicks) / wallNs : 1;
+        if (ticksPerNs <= 0) ticksPerNs = 1;
+
+        ProfileThreadData total = {};
+        for (ProfileThreadData *t : threads) {
+            for (int i = 0; i < PROFILE_NUM_STAGES; ++i) {
+                total.ticks[i] += t->ticks[i];
+                total.calls[i] += t->calls[i];
+                total.allocs[i] += t->allocs[i];
+            }
+            for (int i = 0; i < PROFILE_NUM_EVENTS; ++i) total.events[i] += t->events[i];
+            total.allocations += t->allocations;
+        }
+
+        out << "{\n  \"wall_ns\": " << (unsigned long long)wallNs << ",\n";
+        out << "  \"ticks_per_ns\": " << ticksPerNs << ",\n";
+        out << "  \"threads\": " << threads.size() << ",\n";
+        out << "  \"allocations\": " << total.allocations << ",\n";
+        out << "  \"stages\": [\n";
+        for (int i = 0; i < PROFILE_NUM_STAGES; ++i) {
+            double ns = total.ticks[i] / ticksPerNs;
+            out << "    {\"name\": \"" << profileStageNames[i] << "\", \"calls\": " << total.calls[i]
+                << ", \"time_ns\": " << (unsigned long long)ns
+                << ", \"ns_per_call\": " << (total.calls[i] ? ns / total.calls[i] : 0)
+                << ", \"allocations\": " << total.allocs[i] << "}" << (i + 1 < PROFILE_NUM_STAGES ? "," : "") << "\n";
+        }
+        out << "  ],\n  \"events\": {";
+        for (int i = 0; i < PROFILE_NUM_EVENTS; ++i) {
+            out << (i ? ", " : "") << "\"" << profileEventNames[i] << "\": " << total.events[i];
+        }
+        out << "},\n  \"caches\": [\n";
+        for (size_t c = 0; c < caches.size(); ++c) {
+            const ProfileSets &p = *caches[c];
+            out << "    {\"size\": " << p.size << ", \"assoc\": " << p.assoc << ", \"block_size\": " << p.blockSize
+                << ", \"sets\": " << p.accesses.size() << ",\n     \"accesses\": [";
+            for (size_t i = 0; i < p.accesses.size(); ++i) out << (i ? "," : "") << p.accesses[i];
+            out << "],\n     \"evictions\": [";
+            for (size_t i = 0; i < p.evictions.size(); ++i) out << (i ? "," : "") << p.evictions[i];
+            out << "]}" << (c + 1 < caches.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+        std::cerr << "Profile written to " << path << "\n";
+    }
+};
+
+inline ProfileRegistry &profileRegistry() {
+    static ProfileRegistry registry;
+    return registry;
+}
+
+// The calling thread's counters. Allocations made while creating them are
+// not counted: operator new only counts once the pointer is set.
+inline thread_local ProfileThreadData *profileThreadData = nullptr;
+
+inline ProfileThreadData &profileThread() {
+    if (!profileThreadData) {
+        ProfileThreadData *t = new ProfileThreadData();
+        profileRegistry().add(t);
+        profileThreadData = t;
+    }
+    return *profileThreadData;
+}
+
+class ProfileTimer {
+private:
+    ProfileThreadData &data;
+    int stage;
+    unsigned long allocsBefore;
+    unsigned long long start;
+
+public:
+    explicit ProfileTimer(int stage)
+        : data(profileThread()), stage(stage), allocsBefore(data.allocations), start(profileTicks()) {}
+    ~ProfileTimer() {
+        data.ticks[stage] += profileTicks() - start;
+        data.calls[stage]++;
+        data.allocs[stage] += data.allocations - allocsBefore;
+    }
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(stage) ProfileTimer PROFILE_CONCAT(profileTimer, __LINE__)(stage)
+#define PROFILE_COUNT(event) (profileThread().events[event]++)
+#define PROFILE_COUNT_N(event, n) (profileThread().events[event] += (n))
+// In a CacheLevel member: set index of that level's profileSets
+#define PROFILE_SET_ACCESS(index) (profileSets->accesses[index]++)
+#define PROFILE_SET_EVICTION(index) (profileSets->evictions[index]++, PROFILE_COUNT(PROFILE_EVICTIONS))
+
+#else
+
+#define PROFILE_SCOPE(stage)
+#define PROFILE_COUNT(event) ((void)0)
+#define PROFILE_COUNT_N(event, n) ((void)0)
+#define PROFILE_SET_ACCESS(index) ((void)0)
+#define PROFILE_SET_EVICTION(index) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef REPLACEMENT_H
+#define REPLACEMENT_H
+
+///////////////////////////////////////////////////////////////////////////
+// Replacement policies for BasicCache / BasicCacheSet
+//
+//    A policy keeps stateBits(assoc) bits of state per way, packed into
+//    the way's metadata word next to its flags and tag (WayStates reads
+//    and writes them), and is called on every hit and fill of a valid
+//    block and when a victim has to be chosen from a full set. Free ways
+//    are always filled lowest way first. Policies are template parameters
+//    of the cache, so all of this inlines into the access path.
+//
+//    setLocal policies keep no state shared between sets, so a cache
+//    split into independently simulated set ranges behaves exactly like
+//    the whole cache (see shard.h).
+//
+//    recencyOrdered policies keep a total order (0 = most recent) in their
+//    state, which printContents uses to list blocks MRU first; the others
+//    list blocks in way order.
+//
+//    repeatHitIsNoop policies change nothing on a hit to the way that was
+//    just hit or filled, so a level can count a repeated access to its
+//    last block as a hit without looking it up (see CacheLevel).
+///////////////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+
+// One set's replacement state: bits [shift, shift + bits) of each way's
+// 64-bit metadata word
+class WayStates {
+private:
+    uint64_t *ways;
+    int shift;
+    uint64_t mask;
+
+public:
+    WayStates(uint64_t *ways, int shift, int bits) : ways(ways), shift(shift), mask((1ULL << bits) - 1) {}
+
+    unsigned int operator[](int way) const { return (unsigned int)((ways[way] >> shift) & mask); }
+    void set(int way, unsigned int value) {
+        ways[way] = (ways[way] & ~(mask << shift)) | ((uint64_t)value << shift);
+    }
+    // set(way, state[way] + 1), which must still fit
+    void increment(int way) { ways[way] += 1ULL << shift; }
+    void incrementIf(int way, bool cond) { ways[way] += (uint64_t)cond << shift; }
+};
+
+// Bits needed to hold 0..n-1
+inline int bitsFor(unsigned int n) {
+    int bits = 0;
+    while (bits < 32 && (1ULL << bits) < n) bits++;
+    return bits;
+}
+
+// True LRU: state is the recency rank of each way, 0 = MRU, assoc-1 = LRU
+class LRUPolicy {
+public:
+    static const bool recencyOrdered = true;
+    static const bool setLocal = true;
+    static const bool repeatHitIsNoop = true;
+    static const char *name() { return "lru"; }
+    static bool supports(int) { return true; }
+    static int stateBits(int assoc) { return bitsFor(assoc); }
+
+    void init(WayStates state, int assoc) {
+        for (int i = 0; i < assoc; ++i) state.set(i, i);
+    }
+    void onHit(WayStates state, int assoc, int way) {
+        unsigned int age = state[way];
+        for (int i = 0; i < assoc; ++i) {
+            state.incrementIf(i, state[i] < age);
+        }
+        state.set(way, 0);
+    }
+    void onFill(WayStates state, int assoc, int way) { onHit(state, assoc, way); }
+    int victim(WayStates state, int assoc) {
+        for (int i = 0; i < assoc; ++i) {
+            if (state[i] == (unsigned int)(assoc - 1)) return i;
+        }
+        return 0;
+    }
+};
+
+// Tree pseudo-LRU over a power-of-two number of ways. state[1..assoc-1]
+// are the tree nodes in heap order; a node bit of 0 points the victim
+// search left, 1 right.
+class TreePLRUPolicy {
+public:
+    static const bool recencyOrdered = false;
+    static const bool setLocal = true;
+    static const bool repeatHitIsNoop = true;
+    static const char *name() { return "plru"; }
+    static bool supports(int assoc) { return assoc > 0 && (assoc & (assoc - 1)) == 0; }
+    static int stateBits(int) { return 1; }
+
+    void init(WayStates state, int assoc) {
+        for (int i = 0; i < assoc; ++i) state.set(i, 0);
+    }
+    void onHit(WayStates state, int assoc, int way) {
+        // Walk from the root, pointing every node away from way
+        int node = 1;
+        for (int half = assoc / 2; half > 0; half /= 2) {
+            bool right = way & half;
+            state.set(node, right ? 0 : 1);
+            node = 2 * node + (right ? 1 : 0);
+        }
+    }
+    void onFill(WayStates state, int assoc, int way) { onHit(state, assoc, way); }
+    int victim(WayStates state, int assoc) {
+        int node = 1, way = 0;
+        for (int half = assoc / 2; half > 0; half /= 2) {
+            if (state[node]) way += half;
+            node = 2 * node + (state[node] ? 1 : 0);
+        }
+        return way;
+    }
+};
+
+// Static re-reference interval prediction with 2-bit RRPVs (Jaleel et al.)
+// Hits predict near re-reference; fills predict long re-reference.
+class SRRIPPolicy {
+public:
+    static const bool recencyOrdered = false;
+    static const bool setLocal = true;
+    static const bool repeatHitIsNoop = false; // fills and hits set different RRPVs
+    static const unsigned int maxRRPV = 3;
+    static const char *name() { return "srrip"; }
+    static bool supports(int) { return true; }
+    static int stateBits(int) { return bitsFor(maxRRPV + 1); }
+
+    void init(WayStates state, int assoc) {
+        for (int i = 0; i < assoc; ++i) state.set(i, maxRRPV);
+    }
+    void onHit(WayStates state, int, int way) { state.set(way, 0); }
+    void onFill(WayStates state, int, int way) { state.set(way, maxRRPV - 1); }
+    int victim(WayStates state, int assoc) {
+        for (;;) {
+            for (int i = 0; i < assoc; ++i) {
+                if (state[i] >= maxRRPV) return i;
+            }
+            for (int i = 0; i < assoc; ++i) state.increment(i);
+        }
+    }
+};
+
+// Bimodal RRIP: like SRRIP, but only one fill in 32 gets the long
+// prediction; the rest are inserted at distant re-reference
+class BRRIPPolicy : public SRRIPPolicy {
+private:
+    unsigned int fills;
+
+public:
+    BRRIPPolicy() : fills(0) {}
+    static const bool setLocal = false; // the fill counter spans all sets
+    static const char *name() { return "brrip"; }
+
+    void onFill(WayStates state, int, int way) {
+        state.set(way, (++fills % 32 == 0) ? maxRRPV - 1 : maxRRPV);
+    }
+};
+
+// Uniform random victim, deterministic xorshift seed per cache
+class RandomPolicy {
+private:
+    unsigned long long seed;
+
+public:
+    RandomPolicy() : seed(0x9E3779B97F4A7C15ULL) {}
+    static const bool recencyOrdered = false;
+    static const bool setLocal = false;
+    static const bool repeatHitIsNoop = true;
+    static const char *name() { return "random"; }
+    static bool supports(int) { return true; }
+    static int stateBits(int) { return 0; }
+
+    void init(WayStates, int) {}
+    void onHit(WayStates, int, int) {}
+    void onFill(WayStates, int, int) {}
+    int victim(WayStates, int assoc) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return (int)(seed % (unsigned long long)assoc);
+    }
+};
+
+#endif
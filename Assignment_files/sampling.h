@@ -0,0 +1,237 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <cmath>
+#include <iomanip>
+#include <vector>
+#include "composed.h"
+
+///////////////////////////////////////////////////////////////////////////
+// Sampled simulation with error bounds (cache_sim --sample-sets / --sample-time)
+//
+//    Set sampling simulates a random subset of the L1 sets. An access to
+//    any other set is dropped after computing its index, before any
+//    lookup. Each sampled set is exact, because its blocks never
+//    interact with other sets. An L2 stays exact too when its set count
+//    is a multiple of L1's: then every L2 set is fed by exactly one L1
+//    set. A victim cache mixes all sets, so it is not supported.
+//
+//    Time sampling splits the trace into periods. Only the last
+//    warm-up + window accesses of each period are simulated in detail,
+//    and only the window is measured. The accesses before them are
+//    functionally warmed (CacheLevel::warm): tags, replacement state,
+//    dirty bits and the VC follow the trace, but nothing is counted.
+//    Without that a large cache would start each window with the
+//    contents of the previous one and overstate the miss rate.
+//
+//    Either way the sample is a set of units (sets or windows), each
+//    with its own counts. Rates use the ratio estimator
+//    R = sum(misses) / sum(accesses). Totals scale the mean per unit by
+//    the number of units in the population. 95% confidence intervals
+//    come from the between-unit variance, with the finite population
+//    correction (1 - n/N).
+///////////////////////////////////////////////////////////////////////////
+
+struct SamplingSpec {
+    int sets;              // sampled L1 sets, 0 = no set sampling
+    unsigned long seed;    // chooses the sampled sets
+    uint64_t period;       // time sampling period in accesses, 0 = off
+    uint64_t window;       // measured accesses per period
+    uint64_t warmup;       // simulated but unmeasured accesses before each window
+};
+
+// Counter deltas attributed to one sampling unit
+struct SampleUnit {
+    double accesses, l1Misses, l1Writebacks, l2Reads, l2ReadMisses, l2Writebacks;
+};
+
+struct Estimate {
+    double value;
+    double halfWidth; // of the 95% confidence interval
+};
+
+template <class H>
+SampleUnit sampleCounters(const H &h) {
+    SimStats s(h);
+    SampleUnit u;
+    u.accesses = s.l1Reads + s.l1Writes;
+    u.l1Misses = s.l1ReadMisses + s.l1WriteMisses - s.swaps;
+    u.l1Writebacks = s.l1Writebacks;
+    u.l2Reads = s.l2Reads;
+    u.l2ReadMisses = s.l2ReadMisses;
+    u.l2Writebacks = s.l2Writebacks;
+    return u;
+}
+
+inline void addDelta(SampleUnit &unit, const SampleUnit &before, const SampleUnit &after) {
+    unit.accesses += after.accesses - before.accesses;
+    unit.l1Misses += after.l1Misses - before.l1Misses;
+    unit.l1Writebacks += after.l1Writebacks - before.l1Writebacks;
+    unit.l2Reads += after.l2Reads - before.l2Reads;
+    unit.l2ReadMisses += after.l2ReadMisses - before.l2ReadMisses;
+    unit.l2Writebacks += after.l2Writebacks - before.l2Writebacks;
+}
+
+// sum(num) / sum(den) over the units, out of a population of N units
+inline Estimate estimateRatio(const std::vector<SampleUnit> &units, double SampleUnit::*num, double SampleUnit::*den,
+                              double N) {
+    double n = units.size(), sumNum = 0, sumDen = 0;
+    for (const SampleUnit &u : units) {
+        sumNum += u.*num;
+        sumDen += u.*den;
+    }
+    if (sumDen == 0) return Estimate{0, 0};
+    double r = sumNum / sumDen;
+    if (n < 2) return Estimate{r, NAN};
+    double ss = 0;
+    for (const SampleUnit &u : units) {
+        double e = u.*num - r * u.*den;
+        ss += e * e;
+    }
+    double meanDen = sumDen / n;
+    double variance = (1 - n / N) * (ss / (n - 1)) / (n * meanDen * meanDen);
+    return Estimate{r, 1.96 * std::sqrt(std::max(variance, 0.0))};
+}
+
+// Population total of field, from n of N units
+inline Estimate estimateTotal(const std::vector<SampleUnit> &units, double SampleUnit::*field, double N) {
+    double n = units.size(), sum = 0;
+    for (const SampleUnit &u : units) sum += u.*field;
+    if (n == 0) return Estimate{0, 0};
+    double mean = sum / n;
+    if (n < 2) return Estimate{N * mean, NAN};
+    double ss = 0;
+    for (const SampleUnit &u : units) ss += (u.*field - mean) * (u.*field - mean);
+    double variance = N * N * (1 - n / N) * (ss / (n - 1)) / n;
+    return Estimate{N * mean, 1.96 * std::sqrt(std::max(variance, 0.0))};
+}
+
+inline void printEstimate(const char *name, const Estimate &e, int precision) {
+    std::cout << "  " << name << std::fixed << std::setprecision(precision) << e.value;
+    if (std::isnan(e.halfWidth)) std::cout << " (too few units for an interval)\n";
+    else std::cout << " +- " << e.halfWidth << " (95% CI)\n";
+}
+
+inline void printSampleReport(const std::vector<SampleUnit> &units, double N, bool hasL2, uint64_t simulated,
+                              uint64_t total) {
+    std::cout << "  accesses simulated:\t\t\t" << simulated << " of " << total << " ("
+              << std::fixed << std::setprecision(2) << (total ? 100.0 * simulated / total : 0) << "%)\n";
+    printEstimate("L1+VC miss rate:\t\t\t", estimateRatio(units, &SampleUnit::l1Misses, &SampleUnit::accesses, N), 4);
+    printEstimate("writebacks from L1/VC:\t\t", estimateTotal(units, &SampleUnit::l1Writebacks, N), 0);
+    if (hasL2) {
+        printEstimate("L2 miss rate:\t\t\t\t", estimateRatio(units, &SampleUnit::l2ReadMisses, &SampleUnit::l2Reads, N), 4);
+        printEstimate("writebacks from L2:\t\t\t", estimateTotal(units, &SampleUnit::l2Writebacks, N), 0);
+    }
+}
+
+// Set sampling on hierarchy h; false with a reason in error if the
+// configuration does not allow it
+template <class H>
+bool runSetSampling(H &h, const std::string &trace_file, const SamplingSpec &spec, std::string &error) {
+    int numSets = h.l1Cache->getNumSets();
+    if (h.config.VC_NUM_BLOCKS > 0) {
+        error = "Set sampling needs a configuration without a victim cache";
+        return false;
+    }
+    if (h.l2Cache && h.l2Cache->getNumSets() % numSets != 0) {
+        error = "Set sampling needs an L2 whose number of sets is a multiple of L1's";
+        return false;
+    }
+
+    // Partial Fisher-Yates shuffle picks spec.sets distinct sets
+    int n = std::min(spec.sets, numSets);
+    std::vector<int> order(numSets);
+    for (int i = 0; i < numSets; ++i) order[i] = i;
+    unsigned long long seed = spec.seed * 0x9E3779B97F4A7C15ULL + 1;
+    std::vector<int> unitOf(numSets, -1); // set -> sample unit, -1 = not sampled
+    for (int i = 0; i < n; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        int j = i + (int)(seed % (unsigned long long)(numSets - i));
+        std::swap(order[i], order[j]);
+        unitOf[order[i]] = i;
+    }
+
+    // Counters only move on sampled accesses, so each one's delta is
+    // against the counters after the previous one
+    std::vector<SampleUnit> units(n, SampleUnit{0, 0, 0, 0, 0, 0});
+    SampleUnit last = sampleCounters(h);
+    uint64_t total = 0, simulated = 0;
+    bool ok = forEachTraceAccess(trace_file, [&](char type, unsigned long address) {
+        total++;
+        int unit = unitOf[h.l1Cache->getIndex(address)];
+        if (unit < 0) return;
+        simulated++;
+        h.access(type, address);
+        SampleUnit now = sampleCounters(h);
+        addDelta(units[unit], last, now);
+        last = now;
+    });
+    if (!ok) {
+        error = "";
+        return false;
+    }
+    std::cout << "===== Sampled simulation (" << n << " of " << numSets << " L1 sets) =====\n";
+    printSampleReport(units, numSets, h.l2Cache != nullptr, simulated, total);
+    return true;
+}
+
+// Time sampling on hierarchy h
+template <class H>
+bool runTimeSampling(H &h, const std::string &trace_file, const SamplingSpec &spec, std::string &error) {
+    if (spec.window == 0 || spec.window + spec.warmup > spec.period) {
+        error = "Time sampling needs 0 < window and window + warm-up <= period";
+        return false;
+    }
+    uint64_t skip = spec.period - spec.window - spec.warmup;
+    std::vector<SampleUnit> units;
+    SampleUnit before = {0, 0, 0, 0, 0, 0};
+    uint64_t total = 0, simulated = 0;
+    bool ok = forEachTraceAccess(trace_file, [&](char type, unsigned long address) {
+        uint64_t offset = total++ % spec.period;
+        if (offset < skip) {
+            h.warm(type, address);
+            return;
+        }
+        bool measured = offset >= skip + spec.warmup;
+        if (measured && offset == skip + spec.warmup) {
+            units.push_back(SampleUnit{0, 0, 0, 0, 0, 0});
+            before = sampleCounters(h);
+        }
+        simulated++;
+        h.access(type, address);
+        if (measured && (offset == spec.period - 1)) addDelta(units.back(), before, sampleCounters(h));
+    });
+    if (!ok) {
+        error = "";
+        return false;
+    }
+    // A window cut short by the end of the trace still counts
+    if (total % spec.period > skip + spec.warmup) addDelta(units.back(), before, sampleCounters(h));
+
+    // The population is every window-sized stretch of the trace, one of
+    // period / window per period being measured
+    double N = (double)((total + spec.window - 1) / spec.window);
+    std::cout << "===== Sampled simulation (" << spec.window << " of every " << spec.period
+              << " accesses, warm-up " << spec.warmup << ") =====\n";
+    printSampleReport(units, N, h.l2Cache != nullptr, simulated, total);
+    return true;
+}
+
+// Sampled run of one configuration on its composed hierarchy
+template <class Policy>
+int runSampling(const CacheConfig &cfg, const std::string &trace_file, const SamplingSpec &spec) {
+    return dispatchComposedShape<Policy>(cfg, [&](auto *tag) {
+        typedef typename std::remove_pointer<decltype(tag)>::type H;
+        H *h = new H(cfg);
+        std::string error;
+        bool ok = spec.sets > 0 ? runSetSampling(*h, trace_file, spec, error)
+                                : runTimeSampling(*h, trace_file, spec, error);
+        delete h;
+        if (!ok && !error.empty()) std::cerr << error << "\n";
+        return ok ? 0 : EXIT_FAILURE;
+    });
+}
+
+#endif
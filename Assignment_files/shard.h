@@ -0,0 +1,141 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <atomic>
+#include <thread>
+#include "pipeline.h"
+
+///////////////////////////////////////////////////////////////////////////
+// Set-sharded parallel simulation of a single cache level
+//
+//    Accesses to different sets of one cache never interact, so the sets
+//    are split into contiguous ranges and each range is simulated by its
+//    own worker thread on a private shard cache. The calling thread
+//    decodes the trace and routes every access into the batch of the
+//    shard that owns its set (through an SPSC ring per shard), rewriting
+//    the address so the shard's smaller cache maps it to the right local
+//    set:
+//
+//       block = address / blockSize, q = block / numSets,
+//       index = block % numSets, shard k owns sets [first_k, first_k + n_k)
+//       local block = q * n_k + (index - first_k)
+//
+//    At the end the shard sets are copied back into the full cache (local
+//    tags mapped back to real block numbers) and the counters are summed,
+//    which gives exactly the serial result.
+//
+//    Only exact for one level without a victim cache (the VC and L2 see
+//    misses from all sets in program order) and for setLocal replacement
+//    policies, and without a write buffer (which sees the writes of all
+//    sets in order); shardingSupported() says which runs qualify, anything
+//    else is simulated serially. Shards take the cache's write policy.
+///////////////////////////////////////////////////////////////////////////
+
+#define SHARD_SLOTS 8 // batches in flight per shard
+
+inline bool shardingSupported(bool setLocalPolicy, int VC_NUM_BLOCKS, int L2_SIZE, int shards) {
+    return shards > 1 && setLocalPolicy && VC_NUM_BLOCKS == 0 && L2_SIZE == 0;
+}
+
+template <class Policy>
+struct CacheShard {
+    int firstSet;
+    int numSets;
+    BasicCache<Policy> *cache;
+    SpscRing<AccessBatch, SHARD_SLOTS> ring;
+    std::atomic<bool> done;
+    AccessBatch *filling; // batch the router is currently appending to
+
+    CacheShard() : firstSet(0), numSets(0), cache(nullptr), done(false), filling(nullptr) {}
+
+    void simulate() {
+        for (;;) {
+            AccessBatch *b = ring.front();
+            if (!b) {
+                if (!done.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                // Everything pushed before done is visible now
+                if (!(b = ring.front())) return;
+            }
+            cache->handleBatch(b->records, b->count);
+            ring.pop();
+        }
+    }
+
+    AccessBatch *nextSlot() {
+        AccessBatch *b;
+        while (!(b = ring.acquire())) std::this_thread::yield();
+        b->count = 0;
+        return b;
+    }
+};
+
+// Simulate trace_file on cache (no VC, no next level) with up to `shards`
+// worker threads, leaving cache in the same state as a serial run
+template <class Policy>
+bool simulateSharded(BasicCache<Policy> &cache, int assoc, int blockSize, const std::string &trace_file, int shards) {
+    int numSets = cache.getNumSets();
+    if (shards > numSets) shards = numSets;
+
+    std::vector<CacheShard<Policy> *> parts;
+    std::vector<int> owner(numSets); // set index -> shard
+    for (int k = 0, first = 0; k < shards; ++k) {
+        CacheShard<Policy> *p = new CacheShard<Policy>();
+        p->firstSet = first;
+        p->numSets = numSets / shards + (k < numSets % shards ? 1 : 0);
+        p->cache = new BasicCache<Policy>(p->numSets * assoc * blockSize, assoc, blockSize);
+        p->cache->setWritePolicy(cache.isWriteBack(), cache.isWriteAllocate());
+        p->filling = p->nextSlot();
+        for (int i = 0; i < p->numSets; ++i) owner[first + i] = k;
+        first += p->numSets;
+        parts.push_back(p);
+    }
+
+    std::vector<std::thread> workers;
+    for (CacheShard<Policy> *p : parts) workers.emplace_back(&CacheShard<Policy>::simulate, p);
+
+    bool ok = forEachTraceAccess(trace_file, [&](char type, unsigned long address) {
+        unsigned long block = address / blockSize;
+        int index = block % numSets;
+        CacheShard<Policy> *p = parts[owner[index]];
+        unsigned long local = (block / numSets) * p->numSets + (index - p->firstSet);
+        AccessBatch *b = p->filling;
+        b->records[b->count++] = Access{local * blockSize, type};
+        if (b->count == PIPELINE_BATCH) {
+            p->ring.push();
+            p->filling = p->nextSlot();
+        }
+    });
+    for (CacheShard<Policy> *p : parts) {
+        if (p->filling->count > 0) p->ring.push();
+        p->done.store(true, std::memory_order_release);
+    }
+    for (std::thread &w : workers) w.join();
+
+    // Merge sets and counters back into the full cache
+    for (CacheShard<Policy> *p : parts) {
+        for (int i = 0; i < p->numSets; ++i) {
+            int index = p->firstSet + i;
+            cache.importSet(*p->cache, i, index, [&](unsigned long localTag) {
+                return (localTag / p->numSets) * numSets + index;
+            });
+        }
+        cache.numReads += p->cache->numReads;
+        cache.numReadMisses += p->cache->numReadMisses;
+        cache.numWrites += p->cache->numWrites;
+        cache.numWriteMisses += p->cache->numWriteMisses;
+        cache.numSwapRequests += p->cache->numSwapRequests;
+        cache.numSwaps += p->cache->numSwaps;
+        cache.numSwapsFromVC += p->cache->numSwapsFromVC;
+        cache.numWritebacks += p->cache->numWritebacks;
+        cache.numFetches += p->cache->numFetches;
+        cache.numWriteThroughs += p->cache->numWriteThroughs;
+        delete p->cache;
+        delete p;
+    }
+    return ok;
+}
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef STACKDIST_H
+#define STACKDIST_H
+
+#include <iomanip>
+#include <unordered_map>
+#include "hierarchy.h"
+
+///////////////////////////////////////////////////////////////////////////
+// Stack-distance (Mattson) analysis
+//
+//    For a fixed block size and number of sets, the LRU stack distance of
+//    an access is the number of distinct blocks of the same set touched
+//    since the previous access to its block. An LRU set of associativity
+//    A hits exactly when the distance is < A, so one pass yields the miss
+//    count of every associativity (and, with one set, of every fully
+//    associative capacity). This matches CacheSet, which allocates on
+//    both read and write misses and replaces LRU.
+//
+//    Each set numbers its accesses with a local clock. A Fenwick tree over
+//    those timestamps marks the latest access of every resident block, so
+//    a distance is the number of marks after the block's last timestamp,
+//    O(log n). When the clock runs off the end of the tree the live marks
+//    are renumbered densely, which keeps memory proportional to the number
+//    of distinct blocks rather than trace length.
+///////////////////////////////////////////////////////////////////////////
+
+class StackDistanceSet {
+private:
+    std::vector<int> tree;               // Fenwick tree over local timestamps, 1-based
+    std::vector<unsigned long> owner;    // block last accessed at each timestamp
+    std::vector<char> live;              // timestamp is a block's latest access
+    unsigned int now;
+    unsigned int numLive;
+
+    void add(unsigned int t, int delta) {
+        for (unsigned int i = t + 1; i < tree.size(); i += i & (0 - i)) tree[i] += delta;
+    }
+    int prefix(unsigned int t) const { // marks at timestamps <= t
+        int sum = 0;
+        for (unsigned int i = t + 1; i > 0; i -= i & (0 - i)) sum += tree[i];
+        return sum;
+    }
+
+    // Renumber live timestamps 0..numLive-1 and rebuild the tree. The
+    // room left is proportional to the live blocks, so a set starts small
+    // (many sets are touched by only a few blocks) and grows
+    // geometrically, and compaction stays O(1) per access amortized.
+    void compact(std::unordered_map<unsigned long, unsigned int> &lastAccess) {
+        unsigned int capacity = numLive * 2 + 16;
+        std::vector<unsigned long> newOwner(capacity);
+        std::vector<char> newLive(capacity, 0);
+        unsigned int next = 0;
+        for (unsigned int t = 0; t < now; ++t) {
+            if (!live[t]) continue;
+            newOwner[next] = owner[t];
+            newLive[next] = 1;
+            lastAccess[owner[t]] = next;
+            next++;
+        }
+        owner.swap(newOwner);
+        live.swap(newLive);
+        now = next;
+        tree.assign(capacity + 1, 0);
+        for (unsigned int i = 1; i <= capacity; ++i) {
+            tree[i] += live[i - 1];
+            unsigned int parent = i + (i & (0 - i));
+            if (parent <= capacity) tree[parent] += tree[i];
+        }
+    }
+
+public:
+    StackDistanceSet() : now(0), numLive(0) {}
+
+    // Returns the stack distance of block, or -1 on first touch.
+    // lastAccess maps each block of this set to its latest timestamp.
+    long access(unsigned long block, std::unordered_map<unsigned long, unsigned int> &lastAccess) {
+        if (now == owner.size()) compact(lastAccess);
+        long distance = -1;
+        auto it = lastAccess.find(block);
+        if (it != lastAccess.end()) {
+            unsigned int prev = it->second;
+            distance = numLive - prefix(prev);
+            add(prev, -1);
+            live[prev] = 0;
+            it->second = now;
+        } else {
+            lastAccess.emplace(block, now);
+            numLive++;
+        }
+        owner[now] = block;
+        live[now] = 1;
+        add(now, 1);
+        now++;
+        return distance;
+    }
+};
+
+// Distance histograms for one set mapping
+class StackDistanceProfile {
+private:
+    int blockSize;
+    int numSets;
+    int maxAssoc;
+    std::vector<StackDistanceSet> sets;
+    std::unordered_map<unsigned long, unsigned int> lastAccess;
+
+public:
+    // hist[d] counts accesses at distance d < maxAssoc; the rest go to far
+    std::vector<long> readHist, writeHist;
+    long readCold, writeCold, readFar, writeFar, reads, writes;
+
+    StackDistanceProfile(int blockSize, int numSets, int maxAssoc)
+        : blockSize(blockSize), numSets(numSets), maxAssoc(maxAssoc), sets(numSets),
+          readHist(maxAssoc, 0), writeHist(maxAssoc, 0),
+          readCold(0), writeCold(0), readFar(0), writeFar(0), reads(0), writes(0) {}
+
+    void access(char type, unsigned long address) {
+        unsigned long block = address / blockSize;
+        long d = sets[block % numSets].access(block, lastAccess);
+        bool isWrite = type == 'w';
+        (isWrite ? writes : reads)++;
+        if (d < 0) (isWrite ? writeCold : readCold)++;
+        else if (d >= maxAssoc) (isWrite ? writeFar : readFar)++;
+        else (isWrite ? writeHist : readHist)[d]++;
+    }
+
+    // Read and write misses of an LRU cache with numSets sets of assoc
+    // ways, for every assoc in 1..maxAssoc at once: [assoc] is the suffix
+    // sum of the histogram from distance assoc on
+    void missCurve(std::vector<long> &readMisses, std::vector<long> &writeMisses) const {
+        readMisses.assign(maxAssoc + 1, 0);
+        writeMisses.assign(maxAssoc + 1, 0);
+        readMisses[maxAssoc] = readCold + readFar;
+        writeMisses[maxAssoc] = writeCold + writeFar;
+        for (int d = maxAssoc - 1; d >= 1; --d) {
+            readMisses[d] = readMisses[d + 1] + readHist[d];
+            writeMisses[d] = writeMisses[d + 1] + writeHist[d];
+        }
+    }
+
+    int getNumSets() const { return numSets; }
+    int getBlockSize() const { return blockSize; }
+};
+
+// cache_sim --stackdist <BLOCKSIZE> <trace_file> [--sets S1,S2,...] [--max-assoc A]
+inline int runStackDistance(int argc, char *argv[]) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " --stackdist <BLOCKSIZE> <trace_file> [--sets S1,S2,...] [--max-assoc A]\n";
+        return EXIT_FAILURE;
+    }
+    int blockSize = atoi(argv[2]);
+    std::string trace_file = argv[3];
+    std::vector<int> setCounts = {1};
+    int maxAssoc = 64;
+    for (int i = 4; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--sets" && i + 1 < argc) {
+            setCounts.clear();
+            std::istringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) setCounts.push_back(atoi(item.c_str()));
+        } else if (arg == "--max-assoc" && i + 1 < argc) {
+            maxAssoc = atoi(argv[++i]);
+        } else {
+            std::cerr << "Unknown stackdist option: " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (blockSize <= 0 || maxAssoc <= 0) {
+        std::cerr << "BLOCKSIZE and max associativity must be positive\n";
+        return EXIT_FAILURE;
+    }
+    for (int s : setCounts) {
+        if (s <= 0) {
+            std::cerr << "Number of sets must be positive\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!traceSupportsBlockSize(trace_file, blockSize)) return EXIT_FAILURE;
+
+    std::vector<StackDistanceProfile *> profiles;
+    for (int s : setCounts) profiles.push_back(new StackDistanceProfile(blockSize, s, maxAssoc));
+    auto feed = [&](char type, unsigned long address) {
+        for (StackDistanceProfile *p : profiles) p->access(type, address);
+    };
+    if (!forEachTraceAccess(trace_file, feed)) return EXIT_FAILURE;
+
+    std::cout << "sets,assoc,size,read_misses,write_misses,miss_rate\n";
+    std::cout << std::fixed << std::setprecision(4);
+    for (StackDistanceProfile *p : profiles) {
+        long total = p->reads + p->writes;
+        std::vector<long> readMisses, writeMisses;
+        p->missCurve(readMisses, writeMisses);
+        for (int assoc = 1; assoc <= maxAssoc; ++assoc) {
+            std::cout << p->getNumSets() << "," << assoc << ","
+                      << (long)p->getNumSets() * assoc * blockSize << ","
+                      << readMisses[assoc] << "," << writeMisses[assoc] << ","
+                      << (total > 0 ? static_cast<double>(readMisses[assoc] + writeMisses[assoc]) / total : 0) << "\n";
+        }
+        delete p;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <cerrno>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include "composed.h"
+#include "pipeline.h"
+
+///////////////////////////////////////////////////////////////////////////
+// Streaming mode: simulate an unbounded access stream from a pipe
+//
+//    cache_sim --stream [--policy P] [--interval N] [--json]
+//              <L1_SIZE> <L1_ASSOC> <L1_BLOCKSIZE> <VC_NUM_BLOCKS> <L2_SIZE> <L2_ASSOC>
+//              <trace_file | ->
+//
+//    Reads text trace lines ("r <hex>" / "w <hex>") from stdin ("-") or a
+//    FIFO as a tracer writes them, and after every N accesses prints one
+//    CSV line (or JSON object) with the statistics of just those N: the
+//    L1+VC miss and swap request rates, L1/VC writebacks, L2 accesses,
+//    miss rate and writebacks, and memory traffic. A shorter last
+//    interval is printed at end of stream. Lines are flushed as they are
+//    printed, so a reader sees every interval as soon as it ends.
+//
+//    Nothing grows with the stream: input is parsed through one
+//    STREAM_CHUNK buffer and simulated as soon as read() returns, so a
+//    slow tracer is never waited on for more than its current line. The
+//    hierarchy is a single composed type (see composed.h).
+///////////////////////////////////////////////////////////////////////////
+
+#define STREAM_DEFAULT_INTERVAL 100000
+#define STREAM_CHUNK (1 << 16) // bytes per read()
+
+// Parses a text trace from a file descriptor into batches of up to
+// PIPELINE_BATCH accesses, as the bytes arrive
+class StreamReader {
+private:
+    int fd;
+    std::vector<char> buffer;
+    size_t carry; // bytes of an incomplete line at the start of buffer
+    std::vector<Access> batch;
+    std::string error;
+
+public:
+    explicit StreamReader(int fd) : fd(fd), buffer(STREAM_CHUNK + 1), carry(0), batch(PIPELINE_BATCH) {}
+
+    // Call f(records, n) for every access until end of stream. Every
+    // complete line read() returned is handed over before the next
+    // read(). Returns false on a read or decode error (see getError).
+    template <class F>
+    bool forEachBatch(F f) {
+        size_t count = 0;
+        for (;;) {
+            ssize_t n = read(fd, &buffer[carry], STREAM_CHUNK - carry);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                error = std::string("Error reading trace stream: ") + strerror(errno);
+                break;
+            }
+            size_t len = carry + n;
+            bool eof = n == 0;
+            if (eof && len == 0) break;
+            if (eof) buffer[len++] = '\n'; // last line without a newline
+            buffer[len] = '\0';
+
+            char *p = &buffer[0], *end = &buffer[0] + len;
+            for (;;) {
+                char *nl = (char *)memchr(p, '\n', end - p);
+                if (!nl) break;
+                *nl = '\0';
+                char type;
+                unsigned long address;
+                if (parseTraceLine(p, type, address)) {
+                    if (type != 'r' && type != 'w') {
+                        error = std::string("Invalid operation type: ") + type;
+                        break;
+                    }
+                    batch[count++] = Access{address, type};
+                    if (count == PIPELINE_BATCH) {
+                        f(batch.data(), count);
+                        count = 0;
+                    }
+                } else if (type != '\0' && type != '\r') {
+                    error = "Malformed trace line";
+                    break;
+                }
+                p = nl + 1;
+            }
+            if (!error.empty()) break;
+            if (count) f(batch.data(), count);
+            count = 0;
+            carry = end - p;
+            if (eof) break;
+            if (carry == STREAM_CHUNK) {
+                error = "Trace line too long";
+                break;
+            }
+            memmove(&buffer[0], p, carry);
+        }
+        if (count) f(batch.data(), count);
+        return error.empty();
+    }
+
+    const std::string &getError() const { return error; }
+};
+
+// Statistics accumulated between two snapshots of a hierarchy
+inline SimStats intervalStats(const SimStats &now, const SimStats &prev) {
+    SimStats d = now;
+    d.l1Reads -= prev.l1Reads;
+    d.l1ReadMisses -= prev.l1ReadMisses;
+    d.l1Writes -= prev.l1Writes;
+    d.l1WriteMisses -= prev.l1WriteMisses;
+    d.swapRequests -= prev.swapRequests;
+    d.swaps -= prev.swaps;
+    d.l1Writebacks -= prev.l1Writebacks;
+    d.l2Reads -= prev.l2Reads;
+    d.l2ReadMisses -= prev.l2ReadMisses;
+    d.l2Writes -= prev.l2Writes;
+    d.l2WriteMisses -= prev.l2WriteMisses;
+    d.l2Writebacks -= prev.l2Writebacks;
+    d.l1Fetches -= prev.l1Fetches;
+    d.l1WriteThroughs -= prev.l1WriteThroughs;
+    d.l2Fetches -= prev.l2Fetches;
+    d.l2WriteThroughs -= prev.l2WriteThroughs;
+    d.coalescedWrites -= prev.coalescedWrites;
+    return d;
+}
+
+// One interval ending after access `position` of the stream
+inline void printInterval(std::ostream &out, long interval, uint64_t position, const SimStats &s, bool json) {
+    out << std::fixed << std::setprecision(4);
+    long accesses = s.l1Reads + s.l1Writes;
+    if (json) {
+        out << "{\"interval\":" << interval << ",\"position\":" << position << ",\"accesses\":" << accesses
+            << ",\"l1_vc_miss_rate\":" << s.l1MissRate() << ",\"swap_request_rate\":" << s.swapRequestRate()
+            << ",\"l1_writebacks\":" << s.l1Writebacks << ",\"l2_reads\":" << s.l2Reads
+            << ",\"l2_writes\":" << s.l2Writes << ",\"l2_miss_rate\":" << s.l2MissRate()
+            << ",\"l2_writebacks\":" << s.l2Writebacks << ",\"memory_traffic\":" << s.memoryTraffic() << "}"
+            << std::endl;
+    } else {
+        out << interval << "," << position << "," << accesses << "," << s.l1MissRate() << "," << s.swapRequestRate()
+            << "," << s.l1Writebacks << "," << s.l2Reads << "," << s.l2Writes << "," << s.l2MissRate() << ","
+            << s.l2Writebacks << "," << s.memoryTraffic() << std::endl;
+    }
+}
+
+template <class Policy>
+int runStreamWith(const CacheConfig &cfg, int fd, uint64_t intervalLength, bool json) {
+    std::unique_ptr<HierarchyRunner> h(makeComposedRunner<Policy>(cfg));
+    if (!json) {
+        std::cout << "interval,position,accesses,l1_vc_miss_rate,swap_request_rate,l1_writebacks,l2_reads,l2_writes,"
+                     "l2_miss_rate,l2_writebacks,memory_traffic"
+                  << std::endl;
+    }
+    SimStats last = h->stats();
+    uint64_t position = 0, intervalEnd = intervalLength;
+    long interval = 0;
+    auto endInterval = [&]() {
+        SimStats now = h->stats();
+        printInterval(std::cout, interval++, position, intervalStats(now, last), json);
+        last = now;
+    };
+    StreamReader reader(fd);
+    bool ok = reader.forEachBatch([&](const Access *records, size_t n) {
+        // Split the batch at interval boundaries
+        while (n > 0) {
+            size_t k = intervalEnd - position < n ? intervalEnd - position : n;
+            h->access(records, k);
+            records += k;
+            n -= k;
+            position += k;
+            if (position == intervalEnd) {
+                endInterval();
+                intervalEnd += intervalLength;
+            }
+        }
+    });
+    if (position + intervalLength > intervalEnd) endInterval(); // the partial last one
+    if (!ok) {
+        std::cerr << reader.getError() << " after " << position << " accesses\n";
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
+
+// One streaming instantiation per replacement policy, selected by --policy
+struct StreamPolicy {
+    const char *name;
+    int (*run)(const CacheConfig &, int, uint64_t, bool);
+    bool (*supports)(const CacheConfig &);
+};
+
+static const StreamPolicy streamPolicies[] = {
+    {LRUPolicy::name(), runStreamWith<LRUPolicy>, BasicHierarchy<LRUPolicy>::supports},
+    {TreePLRUPolicy::name(), runStreamWith<TreePLRUPolicy>, BasicHierarchy<TreePLRUPolicy>::supports},
+    {SRRIPPolicy::name(), runStreamWith<SRRIPPolicy>, BasicHierarchy<SRRIPPolicy>::supports},
+    {BRRIPPolicy::name(), runStreamWith<BRRIPPolicy>, BasicHierarchy<BRRIPPolicy>::supports},
+    {RandomPolicy::name(), runStreamWith<RandomPolicy>, BasicHierarchy<RandomPolicy>::supports},
+};
+
+inline int runStream(int argc, char *argv[]) {
+    std::string policyName = "lru";
+    uint64_t intervalLength = STREAM_DEFAULT_INTERVAL;
+    bool json = false;
+    std::vector<std::string> args;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--policy" && i + 1 < argc) policyName = argv[++i];
+        else if (arg == "--interval" && i + 1 < argc) intervalLength = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--json") json = true;
+        else args.push_back(arg);
+    }
+    if (args.size() != 7 || intervalLength == 0) {
+        std::cerr << "Usage: " << argv[0] << " --stream [--policy P] [--interval N] [--json] <L1_SIZE> <L1_ASSOC>"
+                     " <L1_BLOCKSIZE> <VC_NUM_BLOCKS> <L2_SIZE> <L2_ASSOC> <trace_file|->\n";
+        return EXIT_FAILURE;
+    }
+    CacheConfig cfg = {atoi(args[0].c_str()), atoi(args[1].c_str()), atoi(args[2].c_str()),
+                       atoi(args[3].c_str()), atoi(args[4].c_str()), atoi(args[5].c_str())};
+    if (!cfg.valid()) {
+        std::cerr << "Cache sizes must divide into whole sets\n";
+        return EXIT_FAILURE;
+    }
+
+    for (const StreamPolicy &p : streamPolicies) {
+        if (policyName != p.name) continue;
+        if (!p.supports(cfg)) {
+            std::cerr << "Replacement policy " << policyName << " does not support this associativity\n";
+            return EXIT_FAILURE;
+        }
+        // Opening a FIFO blocks until the tracer opens its end
+        int fd = args[6] == "-" ? 0 : open(args[6].c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Error opening trace file: " << args[6] << "\n";
+            return EXIT_FAILURE;
+        }
+        int status = p.run(cfg, fd, intervalLength, json);
+        if (fd != 0) close(fd);
+        return status;
+    }
+    std::cerr << "Unknown replacement policy: " << policyName << "\n";
+    return EXIT_FAILURE;
+}
+
+#endif
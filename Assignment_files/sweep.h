@@ -0,0 +1,318 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <atomic>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <thread>
+#include "barrier.h"
+#include "composed.h"
+#include "parse.h"
+
+///////////////////////////////////////////////////////////////////////////
+// Sweep mode: decode the trace once and stream it through every
+// configuration of a grid, one result row per configuration. Only two
+// windows of the trace are in memory at a time (runSweepConfigs).
+//
+//    Grid file, one parameter per line followed by its values; the grid
+//    is the cross product. Missing parameters default to 0 (no VC / L2):
+//
+//       # comment
+//       L1_SIZE 1024 2048 4096
+//       L1_ASSOC 1 2 4
+//       L1_BLOCKSIZE 16 32
+//       VC_NUM_BLOCKS 0 16
+//       L2_SIZE 0 8192
+//       L2_ASSOC 4
+//
+//    A value that isn't an integer is an error. Combinations that don't
+//    divide into whole sets, or whose associativity the replacement
+//    policy doesn't support, are skipped with a note on stderr.
+//
+//    With --cacti, CACTI access time / energy / area of L1 and L2 are
+//    appended to every row. They come from the memoized CactiTable, and
+//    configs missing from it are run through CACTI concurrently up front.
+///////////////////////////////////////////////////////////////////////////
+
+// Accesses handed to every hierarchy of a worker before moving on
+#define SWEEP_CHUNK 4096
+// Accesses decoded ahead of the workers; two windows (16 B per access)
+// are all of the trace a sweep holds in memory
+#define SWEEP_WINDOW (1 << 18)
+
+// "L1 1024/2/16 VC 8 L2 8192/4", to name a config in messages
+inline std::string describeConfig(const CacheConfig &c) {
+    std::ostringstream out;
+    out << "L1 " << c.L1_SIZE << "/" << c.L1_ASSOC << "/" << c.L1_BLOCKSIZE << " VC " << c.VC_NUM_BLOCKS;
+    if (c.L2_SIZE) out << " L2 " << c.L2_SIZE << "/" << c.L2_ASSOC;
+    return out.str();
+}
+
+inline bool parseSweepGrid(const std::string &path, std::vector<CacheConfig> &configs) {
+    std::ifstream in(path);
+    if (!in) return false;
+    const char *keys[] = {"L1_SIZE", "L1_ASSOC", "L1_BLOCKSIZE", "VC_NUM_BLOCKS", "L2_SIZE", "L2_ASSOC"};
+    std::map<std::string, std::vector<int>> values;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream iss(line);
+        std::string key;
+        if (!(iss >> key) || key[0] == '#') continue;
+        bool known = false;
+        for (const char *k : keys) known |= key == k;
+        if (!known) {
+            std::cerr << "Unknown sweep parameter: " << key << "\n";
+            return false;
+        }
+        int v;
+        while (iss >> v) values[key].push_back(v);
+        if (!iss.eof()) {
+            std::cerr << "Invalid value for sweep parameter " << key << ": " << line << "\n";
+            return false;
+        }
+    }
+    for (const char *k : keys) {
+        if (values[k].empty()) values[k].push_back(0);
+    }
+
+    configs.clear();
+    for (int l1Size : values["L1_SIZE"])
+    for (int l1Assoc : values["L1_ASSOC"])
+    for (int blockSize : values["L1_BLOCKSIZE"])
+    for (int vc : values["VC_NUM_BLOCKS"])
+    for (int l2Size : values["L2_SIZE"])
+    for (int l2Assoc : values["L2_ASSOC"]) {
+        CacheConfig cfg = {l1Size, l1Assoc, blockSize, vc, l2Size, l2Size ? l2Assoc : 0};
+        // L2_ASSOC doesn't matter without an L2, keep a single row for it
+        if (l2Size == 0 && l2Assoc != values["L2_ASSOC"][0]) continue;
+        if (!cfg.valid()) {
+            std::cerr << "Skipping " << describeConfig(cfg) << ": sizes don't divide into whole sets\n";
+            continue;
+        }
+        configs.push_back(cfg);
+    }
+    return true;
+}
+
+// CACTI numbers for one sweep row (zero for a level that doesn't exist)
+struct SweepCacti {
+    float l1AccessTime, l1Energy, l1Area;
+    float l2AccessTime, l2Energy, l2Area;
+};
+
+inline void printSweepRow(std::ostream &out, const CacheConfig &c, const SimStats &s, bool json,
+                          const SweepCacti *cacti = nullptr) {
+    out << std::fixed << std::setprecision(4);
+    if (json) {
+        out << "{\"L1_SIZE\":" << c.L1_SIZE << ",\"L1_ASSOC\":" << c.L1_ASSOC
+            << ",\"L1_BLOCKSIZE\":" << c.L1_BLOCKSIZE << ",\"VC_NUM_BLOCKS\":" << c.VC_NUM_BLOCKS
+            << ",\"L2_SIZE\":" << c.L2_SIZE << ",\"L2_ASSOC\":" << c.L2_ASSOC
+            << ",\"l1_reads\":" << s.l1Reads << ",\"l1_read_misses\":" << s.l1ReadMisses
+            << ",\"l1_writes\":" << s.l1Writes << ",\"l1_write_misses\":" << s.l1WriteMisses
+            << ",\"swap_requests\":" << s.swapRequests << ",\"swap_request_rate\":" << s.swapRequestRate()
+            << ",\"swaps\":" << s.swaps << ",\"l1_vc_miss_rate\":" << s.l1MissRate()
+            << ",\"l1_writebacks\":" << s.l1Writebacks
+            << ",\"l2_reads\":" << s.l2Reads << ",\"l2_read_misses\":" << s.l2ReadMisses
+            << ",\"l2_writes\":" << s.l2Writes << ",\"l2_write_misses\":" << s.l2WriteMisses
+            << ",\"l2_miss_rate\":" << s.l2MissRate() << ",\"l2_writebacks\":" << s.l2Writebacks
+            << ",\"memory_traffic\":" << s.memoryTraffic();
+        if (cacti) {
+            out << std::defaultfloat << std::setprecision(6)
+                << ",\"l1_access_time\":" << cacti->l1AccessTime << ",\"l1_energy\":" << cacti->l1Energy
+                << ",\"l1_area\":" << cacti->l1Area << ",\"l2_access_time\":" << cacti->l2AccessTime
+                << ",\"l2_energy\":" << cacti->l2Energy << ",\"l2_area\":" << cacti->l2Area;
+        }
+        out << "}\n";
+    } else {
+        out << c.L1_SIZE << "," << c.L1_ASSOC << "," << c.L1_BLOCKSIZE << "," << c.VC_NUM_BLOCKS << ","
+            << c.L2_SIZE << "," << c.L2_ASSOC << ","
+            << s.l1Reads << "," << s.l1ReadMisses << "," << s.l1Writes << "," << s.l1WriteMisses << ","
+            << s.swapRequests << "," << s.swapRequestRate() << "," << s.swaps << "," << s.l1MissRate() << ","
+            << s.l1Writebacks << "," << s.l2Reads << "," << s.l2ReadMisses << "," << s.l2Writes << ","
+            << s.l2WriteMisses << "," << s.l2MissRate() << "," << s.l2Writebacks << "," << s.memoryTraffic();
+        if (cacti) {
+            out << std::defaultfloat << std::setprecision(6) << "," << cacti->l1AccessTime << "," << cacti->l1Energy << "," << cacti->l1Area
+                << "," << cacti->l2AccessTime << "," << cacti->l2Energy << "," << cacti->l2Area;
+        }
+        out << "\n";
+    }
+}
+
+inline void printSweepHeader(std::ostream &out, bool cacti) {
+    out << "L1_SIZE,L1_ASSOC,L1_BLOCKSIZE,VC_NUM_BLOCKS,L2_SIZE,L2_ASSOC,"
+           "l1_reads,l1_read_misses,l1_writes,l1_write_misses,swap_requests,swap_request_rate,swaps,"
+           "l1_vc_miss_rate,l1_writebacks,l2_reads,l2_read_misses,l2_writes,l2_write_misses,"
+           "l2_miss_rate,l2_writebacks,memory_traffic";
+    if (cacti) out << ",l1_access_time,l1_energy,l1_area,l2_access_time,l2_energy,l2_area";
+    out << "\n";
+}
+
+// Run every config over the trace in traceFile, read once and never held
+// whole: the main thread decodes the next window of SWEEP_WINDOW accesses
+// while the workers simulate the current one, with a barrier between
+// windows. Worker t owns configs t, t+nthreads, ... and feeds each window
+// to all of them chunk by chunk so each chunk is reused from cache across
+// the worker's hierarchies. Each config runs on the composed hierarchy of
+// its shape (see composed.h), so the only indirect call is one per chunk.
+// Returns false, with the reason printed, if the trace can't be read.
+template <class Policy>
+bool runSweepConfigs(const std::vector<CacheConfig> &configs, const std::string &traceFile, int nthreads,
+                     std::vector<SimStats> &results) {
+    std::vector<HierarchyRunner *> hierarchies;
+    for (const CacheConfig &cfg : configs) hierarchies.push_back(makeComposedRunner<Policy>(cfg));
+
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > (int)configs.size()) nthreads = configs.size();
+    std::vector<Access> window, next; // simulated, being decoded
+    window.reserve(SWEEP_WINDOW);
+    next.reserve(SWEEP_WINDOW);
+    EpochBarrier barrier(nthreads + 1);
+    bool finished = false;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < nthreads; ++t) {
+        workers.emplace_back([&, t]() {
+            for (;;) {
+                barrier.wait(); // a window is published, or the trace ended
+                if (finished) return;
+                for (size_t begin = 0; begin < window.size(); begin += SWEEP_CHUNK) {
+                    size_t end = std::min(window.size(), begin + SWEEP_CHUNK);
+                    for (size_t c = t; c < hierarchies.size(); c += nthreads) {
+                        hierarchies[c]->access(&window[begin], end - begin);
+                    }
+                }
+                barrier.wait(); // done with the window
+            }
+        });
+    }
+    bool running = false;
+    auto publish = [&]() {
+        if (running) barrier.wait();
+        window.swap(next);
+        next.clear();
+        running = true;
+        barrier.wait();
+    };
+    bool ok = forEachTraceAccess(traceFile, [&](char type, unsigned long address) {
+        next.push_back(Access{address, type});
+        if (next.size() == SWEEP_WINDOW) publish();
+    });
+    if (ok && !next.empty()) publish();
+    if (running) barrier.wait();
+    finished = true;
+    barrier.wait();
+    for (std::thread &w : workers) w.join();
+
+    results.clear();
+    for (HierarchyRunner *h : hierarchies) {
+        results.push_back(h->stats());
+        delete h;
+    }
+    return ok;
+}
+
+// One sweep instantiation per replacement policy, selected by --policy
+struct SweepPolicy {
+    const char *name;
+    bool (*run)(const std::vector<CacheConfig> &, const std::string &, int, std::vector<SimStats> &);
+    bool (*supports)(const CacheConfig &);
+};
+
+// Drop the configs policy can't simulate (e.g. tree-PLRU needs
+// power-of-two associativity), with a note on stderr for each
+inline void keepSupportedConfigs(const SweepPolicy &policy, std::vector<CacheConfig> &configs) {
+    std::vector<CacheConfig> supported;
+    for (const CacheConfig &c : configs) {
+        if (policy.supports(c)) supported.push_back(c);
+        else std::cerr << "Skipping " << describeConfig(c) << ": " << policy.name << " doesn't support its associativity\n";
+    }
+    configs.swap(supported);
+}
+
+static const SweepPolicy sweepPolicies[] = {
+    {LRUPolicy::name(), runSweepConfigs<LRUPolicy>, BasicHierarchy<LRUPolicy>::supports},
+    {TreePLRUPolicy::name(), runSweepConfigs<TreePLRUPolicy>, BasicHierarchy<TreePLRUPolicy>::supports},
+    {SRRIPPolicy::name(), runSweepConfigs<SRRIPPolicy>, BasicHierarchy<SRRIPPolicy>::supports},
+    {BRRIPPolicy::name(), runSweepConfigs<BRRIPPolicy>, BasicHierarchy<BRRIPPolicy>::supports},
+    {RandomPolicy::name(), runSweepConfigs<RandomPolicy>, BasicHierarchy<RandomPolicy>::supports},
+};
+
+// cache_sim --sweep <grid_file> <trace_file> [--json] [--cacti] [--policy P] [-j N]
+inline int runSweep(int argc, char *argv[]) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " --sweep <grid_file> <trace_file> [--json] [--cacti] [--policy P] [-j threads]\n";
+        return EXIT_FAILURE;
+    }
+    std::string grid_file = argv[2], trace_file = argv[3];
+    bool json = false, cacti = false;
+    std::string policyName = "lru";
+    int nthreads = std::thread::hardware_concurrency();
+    for (int i = 4; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--json") json = true;
+        else if (arg == "--cacti") cacti = true;
+        else if (arg == "--policy" && i + 1 < argc) policyName = argv[++i];
+        else if (arg == "-j" && i + 1 < argc) nthreads = atoi(argv[++i]);
+        else {
+            std::cerr << "Unknown sweep option: " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    const SweepPolicy *policy = nullptr;
+    for (const SweepPolicy &p : sweepPolicies) {
+        if (policyName == p.name) policy = &p;
+    }
+    if (!policy) {
+        std::cerr << "Unknown replacement policy: " << policyName << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<CacheConfig> configs;
+    if (!parseSweepGrid(grid_file, configs)) {
+        std::cerr << "Error reading sweep grid: " << grid_file << "\n";
+        return EXIT_FAILURE;
+    }
+    keepSupportedConfigs(*policy, configs);
+    for (const CacheConfig &c : configs) {
+        if (!traceSupportsBlockSize(trace_file, c.L1_BLOCKSIZE)) return EXIT_FAILURE;
+    }
+
+    // CACTI runs in other processes, so prefetch it while the trace is replayed
+    CactiTable table;
+    std::thread cactiPrefetch;
+    if (cacti) {
+        std::vector<CactiConfig> cactiConfigs;
+        for (const CacheConfig &c : configs) {
+            cactiConfigs.push_back(CactiConfig{(unsigned)c.L1_SIZE, (unsigned)c.L1_BLOCKSIZE, (unsigned)c.L1_ASSOC});
+            if (c.L2_SIZE > 0) {
+                cactiConfigs.push_back(CactiConfig{(unsigned)c.L2_SIZE, (unsigned)c.L1_BLOCKSIZE, (unsigned)c.L2_ASSOC});
+            }
+        }
+        cactiPrefetch = std::thread([&table, cactiConfigs, nthreads]() { table.prefetch(cactiConfigs, nthreads); });
+    }
+
+    std::vector<SimStats> results;
+    bool ok = policy->run(configs, trace_file, nthreads, results);
+    if (cacti) cactiPrefetch.join();
+    if (!ok) return EXIT_FAILURE;
+
+    if (!json) printSweepHeader(std::cout, cacti);
+    for (size_t i = 0; i < configs.size(); ++i) {
+        const CacheConfig &c = configs[i];
+        SweepCacti row = {0, 0, 0, 0, 0, 0};
+        if (cacti) {
+            if (table.lookup(c.L1_SIZE, c.L1_BLOCKSIZE, c.L1_ASSOC, &row.l1AccessTime, &row.l1Energy, &row.l1Area) > 0) {
+                std::cerr << "CACTI failed for L1 config " << c.L1_SIZE << "/" << c.L1_BLOCKSIZE << "/" << c.L1_ASSOC << "\n";
+            }
+            if (c.L2_SIZE > 0 &&
+                table.lookup(c.L2_SIZE, c.L1_BLOCKSIZE, c.L2_ASSOC, &row.l2AccessTime, &row.l2Energy, &row.l2Area) > 0) {
+                std::cerr << "CACTI failed for L2 config " << c.L2_SIZE << "/" << c.L1_BLOCKSIZE << "/" << c.L2_ASSOC << "\n";
+            }
+        }
+        printSweepRow(std::cout, c, results[i], json, cacti ? &row : nullptr);
+    }
+    return 0;
+}
+
+#endif
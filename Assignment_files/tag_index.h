@@ -0,0 +1,68 @@
+#ifndef TAG_INDEX_H
+#define TAG_INDEX_H
+
+#include <vector>
+#include <cstddef>
+
+///////////////////////////////////////////////////////////////////////////
+// Fixed-capacity tag -> slot hash index
+//
+//    Open addressing with linear probing over a power-of-two table at
+//    least twice the number of slots it has to index, so probe runs stay
+//    short and nothing is allocated after construction. Erase shifts the
+//    rest of the probe run back instead of leaving tombstones, so lookups
+//    never slow down over a long trace. Used by the fully associative
+//    structures (VictimCache, ShadowCache) to find a block in O(1).
+///////////////////////////////////////////////////////////////////////////
+
+class TagIndex {
+private:
+    std::vector<unsigned long> tags;
+    std::vector<int> slots; // -1 = empty bucket
+    size_t mask;
+
+    size_t home(unsigned long tag) const {
+        return (size_t)((tag * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    }
+    size_t bucket(unsigned long tag) const {
+        size_t b = home(tag);
+        while (slots[b] >= 0 && tags[b] != tag) b = (b + 1) & mask;
+        return b;
+    }
+
+public:
+    explicit TagIndex(int capacity) {
+        size_t buckets = 1;
+        while (buckets < 2 * (size_t)capacity) buckets <<= 1;
+        tags.assign(buckets, 0);
+        slots.assign(buckets, -1);
+        mask = buckets - 1;
+    }
+
+    // Slot of tag, or -1
+    int find(unsigned long tag) const { return slots[bucket(tag)]; }
+
+    // Map tag to slot, replacing any previous mapping
+    void set(unsigned long tag, int slot) {
+        size_t b = bucket(tag);
+        tags[b] = tag;
+        slots[b] = slot;
+    }
+
+    void erase(unsigned long tag) {
+        size_t hole = bucket(tag);
+        if (slots[hole] < 0) return;
+        slots[hole] = -1;
+        for (size_t b = (hole + 1) & mask; slots[b] >= 0; b = (b + 1) & mask) {
+            // b may move into the hole unless its home lies cyclically in (hole, b]
+            if (((b - home(tags[b])) & mask) >= ((b - hole) & mask)) {
+                tags[hole] = tags[b];
+                slots[hole] = slots[b];
+                slots[b] = -1;
+                hole = b;
+            }
+        }
+    }
+};
+
+#endif
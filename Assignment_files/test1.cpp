@@ -11,22 +11,145 @@
 // Assuming Cache and VictimCache classes are defined elsewhere
 #include "cache_sim.cc"
 #include "parse.h"
+#include "trace.h"
+#include "pipeline.h"
+#include "shard.h"
+#include "composed.h"
+#include "checkpoint.h"
+#include "sampling.h"
+#include "multicore.h"
+#include "sweep.h"
+#include "stackdist.h"
+#include "optimize.h"
+#include "stream.h"
+
+// Options of a normal simulation run
+struct SimOptions {
+    std::string policy; // replacement policy name
+    int shards;         // worker threads for set-sharded simulation
+    bool pipelineL2;    // simulate L2 on its own thread fed by an event queue
+    bool classify;      // report compulsory/capacity/conflict misses per level
+    std::string restoreState; // start from this checkpoint (see checkpoint.h)
+    std::string saveState;    // write a checkpoint when the run stops
+    uint64_t stopAt;          // stop after this many trace accesses
+    SamplingSpec sampling;    // --sample-sets / --sample-time (see sampling.h)
+    std::string prefetch[2];  // prefetcher kind of L1 and L2, empty for none (see prefetch.h)
+    int prefetchDegree[2];
+    bool writeBack[2];        // per level, else write-through (see --write-policy)
+    bool writeAllocate[2];
+    int writeBuffer;          // entries of the write buffer in front of memory, 0 for none (see writebuffer.h)
+
+    bool checkpointing() const { return !restoreState.empty() || !saveState.empty() || stopAt != UINT64_MAX; }
+    bool sampled() const { return sampling.sets > 0 || sampling.period > 0; }
+    bool prefetching() const { return !prefetch[0].empty() || !prefetch[1].empty(); }
+    bool defaultWrites() const {
+        return writeBack[0] && writeBack[1] && writeAllocate[0] && writeAllocate[1] && writeBuffer == 0;
+    }
+};
 
 // Function to parse command line arguments
 void parseArguments(int argc, char *argv[], int &L1_SIZE, int &L1_ASSOC, int &L1_BLOCKSIZE,
-                    int &VC_NUM_BLOCKS, int &L2_SIZE, int &L2_ASSOC, std::string &trace_file) {
-    if (argc != 7 && argc != 8) {
-        std::cerr << "Usage: " << argv[0] << " <L1_SIZE> <L1_ASSOC> <L1_BLOCKSIZE> <VC_NUM_BLOCKS> <L2_SIZE> <L2_ASSOC> <trace_file>\n";
+                    int &VC_NUM_BLOCKS, int &L2_SIZE, int &L2_ASSOC, std::string &trace_file, SimOptions &options) {
+    // Options may appear anywhere, everything else is positional
+    std::vector<char *> args;
+    options.policy = "lru";
+    options.shards = 1;
+    options.pipelineL2 = false;
+    options.classify = false;
+    options.stopAt = UINT64_MAX;
+    options.sampling = SamplingSpec{0, 1, 0, 0, 0};
+    options.prefetchDegree[0] = options.prefetchDegree[1] = PREFETCH_DEFAULT_DEGREE;
+    options.writeBack[0] = options.writeBack[1] = true;
+    options.writeAllocate[0] = options.writeAllocate[1] = true;
+    options.writeBuffer = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--policy" && i + 1 < argc) options.policy = argv[++i];
+        else if (arg == "--shards" && i + 1 < argc) options.shards = atoi(argv[++i]);
+        else if (arg == "--pipeline-l2") options.pipelineL2 = true;
+        else if (arg == "--classify") options.classify = true;
+        else if (arg == "--restore-state" && i + 1 < argc) options.restoreState = argv[++i];
+        else if (arg == "--save-state" && i + 1 < argc) options.saveState = argv[++i];
+        else if (arg == "--stop-at" && i + 1 < argc) options.stopAt = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--sample-sets" && i + 1 < argc) options.sampling.sets = atoi(argv[++i]);
+        else if (arg == "--sample-seed" && i + 1 < argc) options.sampling.seed = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--sample-time" && i + 1 < argc) {
+            // PERIOD,WINDOW[,WARMUP]
+            SamplingSpec &t = options.sampling;
+            unsigned long long period = 0, window = 0, warmup = 0;
+            if (sscanf(argv[++i], "%llu,%llu,%llu", &period, &window, &warmup) < 2 || period == 0) {
+                std::cerr << "--sample-time expects PERIOD,WINDOW[,WARMUP]\n";
+                exit(EXIT_FAILURE);
+            }
+            t.period = period;
+            t.window = window;
+            t.warmup = warmup;
+        }
+        else if (arg == "--prefetch" && i + 1 < argc) {
+            // LEVEL:KIND[:DEGREE], LEVEL l1 or l2
+            std::string spec = argv[++i];
+            size_t colon = spec.find(':');
+            int level = spec.compare(0, colon, "l1") == 0 ? 0 : (spec.compare(0, colon, "l2") == 0 ? 1 : -1);
+            std::string kind = colon == std::string::npos ? "" : spec.substr(colon + 1);
+            int degree = PREFETCH_DEFAULT_DEGREE;
+            size_t colon2 = kind.find(':');
+            if (colon2 != std::string::npos) {
+                degree = atoi(kind.c_str() + colon2 + 1);
+                kind.resize(colon2);
+            }
+            Prefetcher *probe = makePrefetcher(kind, degree);
+            if (level < 0 || !probe || degree < 1 || degree > PREFETCH_MAX_DEGREE) {
+                std::cerr << "--prefetch expects l1|l2:next-line|stride|stream[:DEGREE], DEGREE 1-" << PREFETCH_MAX_DEGREE << "\n";
+                exit(EXIT_FAILURE);
+            }
+            delete probe;
+            options.prefetch[level] = kind;
+            options.prefetchDegree[level] = degree;
+        }
+        else if (arg == "--write-policy" && i + 1 < argc) {
+            // LEVEL:wb|wt[:wa|nwa], LEVEL l1 or l2
+            std::string spec = argv[++i];
+            std::vector<std::string> parts;
+            for (size_t begin = 0, end; begin <= spec.size(); begin = end + 1) {
+                end = spec.find(':', begin);
+                if (end == std::string::npos) end = spec.size();
+                parts.push_back(spec.substr(begin, end - begin));
+            }
+            int level = parts[0] == "l1" ? 0 : (parts[0] == "l2" ? 1 : -1);
+            if (level < 0 || parts.size() < 2 || parts.size() > 3 || (parts[1] != "wb" && parts[1] != "wt") ||
+                (parts.size() == 3 && parts[2] != "wa" && parts[2] != "nwa")) {
+                std::cerr << "--write-policy expects l1|l2:wb|wt[:wa|nwa]\n";
+                exit(EXIT_FAILURE);
+            }
+            options.writeBack[level] = parts[1] == "wb";
+            options.writeAllocate[level] = parts.size() < 3 || parts[2] == "wa";
+        }
+        else if (arg == "--write-buffer" && i + 1 < argc) {
+            options.writeBuffer = atoi(argv[++i]);
+            if (options.writeBuffer < 1) {
+                std::cerr << "--write-buffer expects a number of entries\n";
+                exit(EXIT_FAILURE);
+            }
+        }
+        else args.push_back(argv[i]);
+    }
+    if (args.size() != 7) {
+        std::cerr << "Usage: " << argv[0] << " [--policy lru|plru|srrip|brrip|random] [--shards N] [--pipeline-l2] [--classify] [--restore-state F] [--stop-at N] [--save-state F] [--sample-sets N [--sample-seed S] | --sample-time PERIOD,WINDOW[,WARMUP]] [--prefetch l1|l2:KIND[:DEGREE]] [--write-policy l1|l2:wb|wt[:wa|nwa]] [--write-buffer N] <L1_SIZE> <L1_ASSOC> <L1_BLOCKSIZE> <VC_NUM_BLOCKS> <L2_SIZE> <L2_ASSOC> <trace_file>\n";
+        std::cerr << "       " << argv[0] << " --sweep <grid_file> <trace_file> [--json] [--cacti] [--policy P] [-j threads]\n";
+        std::cerr << "       " << argv[0] << " --optimize <grid_file> <trace_file> [--max-area MM2] [--max-energy NJ] [--json] [--policy P] [-j threads]\n";
+        std::cerr << "       " << argv[0] << " --stackdist <BLOCKSIZE> <trace_file> [--sets S1,S2,...] [--max-assoc A]\n";
+        std::cerr << "       " << argv[0] << " --multicore [--policy P] [--epoch N] [-j threads] <L1_SIZE> ... <L2_ASSOC> <trace_core0> [<trace_core1> ...]\n";
+        std::cerr << "       " << argv[0] << " --stream [--policy P] [--interval N] [--json] <L1_SIZE> ... <L2_ASSOC> <trace_file|->\n";
         exit(EXIT_FAILURE);
     }
     
-    std::istringstream(argv[1]) >> L1_SIZE;
-    std::istringstream(argv[2]) >> L1_ASSOC;
-    std::istringstream(argv[3]) >> L1_BLOCKSIZE;
-    std::istringstream(argv[4]) >> VC_NUM_BLOCKS;
-    std::istringstream(argv[5]) >> L2_SIZE;
-    std::istringstream(argv[6]) >> L2_ASSOC;
-    trace_file = argv[7];
+    std::istringstream(args[0]) >> L1_SIZE;
+    std::istringstream(args[1]) >> L1_ASSOC;
+    std::istringstream(args[2]) >> L1_BLOCKSIZE;
+    std::istringstream(args[3]) >> VC_NUM_BLOCKS;
+    std::istringstream(args[4]) >> L2_SIZE;
+    std::istringstream(args[5]) >> L2_ASSOC;
+    trace_file = args[6];
      std::cout<<"===== Simulator configuration =====\n"; 
         std::cout<<"L1_SIZE:\t\t"<<L1_SIZE<<"\n"; 
         std::cout<<"L1_ASSOC:\t\t"<<L1_ASSOC<<"\n"; 
@@ -35,61 +158,117 @@ void parseArguments(int argc, char *argv[], int &L1_SIZE, int &L1_ASSOC, int &L1
         std::cout<<"L2_SIZE:\t\t"<<L2_SIZE<<"\n"; 
         std::cout<<"L2_ASSOC:\t\t"<<L2_ASSOC<<"\n"; 
         std::cout<<"trace_file:\t\t"<<trace_file<<"\n"; 
+        if (options.policy != "lru") std::cout<<"replacement_policy:\t"<<options.policy<<"\n";
+        for (int level = 0; level < 2; ++level) {
+            if (!options.prefetch[level].empty()) {
+                std::cout << "L" << level + 1 << "_prefetcher:\t\t" << options.prefetch[level] << " (degree "
+                          << options.prefetchDegree[level] << ")\n";
+            }
+        }
+        for (int level = 0; level < 2; ++level) {
+            if (!options.writeBack[level] || !options.writeAllocate[level]) {
+                std::cout << "L" << level + 1 << "_write_policy:\t\t"
+                          << (options.writeBack[level] ? "write-back" : "write-through") << ", "
+                          << (options.writeAllocate[level] ? "write-allocate" : "no-write-allocate") << "\n";
+            }
+        }
+        if (options.writeBuffer > 0) std::cout << "write_buffer:\t\t" << options.writeBuffer << " entries\n";
         
 }
 
-int main(int argc, char *argv[]) {
-    // Parse command-line arguments
-    int L1_SIZE, L1_ASSOC, L1_BLOCKSIZE, VC_NUM_BLOCKS, L2_SIZE, L2_ASSOC;
-    std::string trace_file;
-    parseArguments(argc, argv, L1_SIZE, L1_ASSOC, L1_BLOCKSIZE, VC_NUM_BLOCKS, L2_SIZE, L2_ASSOC, trace_file);
-    
-    // Initialize L1 Cache
-    Cache *l2Cache = nullptr;
-    if (L2_SIZE > 0) {
-        l2Cache = new Cache(L2_SIZE, L2_ASSOC, L1_BLOCKSIZE);
+// Compulsory/capacity/conflict misses of one level, reads and writes
+void printMissClasses(const std::string &level, const MissClassifier &c) {
+    const char *names[] = {"compulsory", "capacity", "conflict"};
+    const long *counts[] = {c.compulsory, c.capacity, c.conflict};
+    long total = c.misses();
+    for (int k = 0; k < 3; ++k) {
+        long n = counts[k][0] + counts[k][1];
+        std::cout << "  " << level << " " << names[k] << " misses:\t\t" << n << " (reads " << counts[k][0]
+                  << ", writes " << counts[k][1] << ", " << std::fixed << std::setprecision(4)
+                  << (total > 0 ? static_cast<double>(n) / total : 0) << " of misses)\n";
     }
-    Cache l1Cache(L1_SIZE, L1_ASSOC, L1_BLOCKSIZE,l2Cache,VC_NUM_BLOCKS);
-    // Initialize Victim Cache if VC_NUM_BLOCKS > 0
-    // VictimCache *l1VictimCache = nullptr;
-    // if (VC_NUM_BLOCKS > 0) {
-    //     l1VictimCache = new VictimCache(VC_NUM_BLOCKS, L1_BLOCKSIZE);
-    // }
+}
 
-    // Initialize L2 Cache if L2_SIZE > 0
-    
-    // Read and process the trace file
-    std::ifstream trace(trace_file);
-    if (!trace) {
-        std::cerr << "Error opening trace file: " << trace_file << "\n";
-        return EXIT_FAILURE;
+// Prefetch statistics of one level
+void printPrefetchStats(const std::string &level, const Prefetcher &p, long demandMisses) {
+    const PrefetchStats &s = p.stats;
+    std::cout << "  " << level << " prefetches issued:\t\t\t" << s.issued << "\n";
+    std::cout << "  " << level << " useful prefetches:\t\t\t" << s.useful << "\n";
+    std::cout << "  " << level << " late prefetches:\t\t\t" << s.late << "\n";
+    std::cout << "  " << level << " polluting prefetches:\t\t" << s.polluting << "\n";
+    std::cout << "  " << level << " prefetch accuracy:\t\t\t" << std::fixed << std::setprecision(4)
+              << (s.issued > 0 ? static_cast<double>(s.useful) / s.issued : 0) << "\n";
+    std::cout << "  " << level << " prefetch coverage:\t\t\t" << std::fixed << std::setprecision(4)
+              << (s.useful + demandMisses > 0 ? static_cast<double>(s.useful) / (s.useful + demandMisses) : 0) << "\n";
+    std::cout << "  " << level << " extra next-level traffic:\t\t" << s.issued - s.useful << "\n";
+}
+
+// Write buffer statistics; trafficWithout is the memory traffic the run
+// would have had without the buffer
+void printWriteBufferStats(const WriteBuffer &b, long trafficWithout) {
+    const WriteBufferStats &s = b.stats;
+    std::cout << "  write buffer entries:\t\t\t" << b.size() << "\n";
+    std::cout << "  writes into the buffer:\t\t" << s.writes << "\n";
+    std::cout << "  coalesced writes:\t\t\t" << s.coalesced << "\n";
+    std::cout << "  memory writes:\t\t\t" << b.memoryWrites() << "\n";
+    std::cout << "  memory traffic saved:\t\t\t" << std::fixed << std::setprecision(4)
+              << (trafficWithout > 0 ? static_cast<double>(s.coalesced) / trafficWithout : 0) << "\n";
+}
+
+// Run simulate() on l1Cache (and l2Cache, nullptr without an L2), then
+// print their contents and statistics. The levels are BasicCaches or the
+// levels of a ComposedHierarchy of configuration cfg.
+template <class L1, class L2, class F>
+int simulateAndPrint(L1 &l1Cache, L2 *l2Cache, const CacheConfig &cfg, const SimOptions &options, F simulate) {
+    int VC_NUM_BLOCKS = cfg.VC_NUM_BLOCKS, L2_SIZE = cfg.L2_SIZE;
+    MissClassifier *l1Classes = nullptr, *l2Classes = nullptr;
+    if (options.classify) {
+        l1Classes = new MissClassifier(l1Cache.getNumBlocks());
+        l1Cache.setClassifier(l1Classes);
+        if (l2Cache) {
+            l2Classes = new MissClassifier(l2Cache->getNumBlocks());
+            l2Cache->setClassifier(l2Classes);
+        }
     }
     
-    float L1accessTime,L1Energy,L1Area;
-    std::string line;
-    while (std::getline(trace, line)) {
-        char type;
-        std::string address_str;
-        std::istringstream iss(line);
-        iss >> type >> address_str;
-        unsigned long address = std::stoull(address_str, nullptr, 16);
-        
-        if (type == 'r') {
-            // Read operation
-            l1Cache.handleRead(address);
-           
-        } else if (type == 'w') {
-            // Write operation
-            l1Cache.handleWrite(address);
-            
-        } else {
-            std::cerr << "Invalid operation type: " << type << "\n";
-            return EXIT_FAILURE;
-        }
+    Prefetcher *prefetchers[2] = {nullptr, nullptr};
+    for (int level = 0; level < 2; ++level) {
+        if (options.prefetch[level].empty() || (level == 1 && !l2Cache)) continue;
+        prefetchers[level] = makePrefetcher(options.prefetch[level], options.prefetchDegree[level]);
+        if (level == 0) l1Cache.setPrefetcher(prefetchers[0]);
+        else l2Cache->setPrefetcher(prefetchers[1]);
+    }
+
+    l1Cache.setWritePolicy(options.writeBack[0], options.writeAllocate[0]);
+    if (l2Cache) l2Cache->setWritePolicy(options.writeBack[1], options.writeAllocate[1]);
+    WriteBuffer *writeBuffer = nullptr;
+    if (options.writeBuffer > 0) {
+        writeBuffer = new WriteBuffer(options.writeBuffer);
+        if (l2Cache) l2Cache->setWriteBuffer(writeBuffer);
+        else l1Cache.setWriteBuffer(writeBuffer);
     }
-    // get_cacti_results(L1_SIZE,L1_BLOCKSIZE,L1_ASSOC,&L1accessTime,&L1Energy,&L1Area);
 
-    trace.close();
+    if (!simulate()) {
+        delete l1Classes;
+        delete l2Classes;
+        delete prefetchers[0];
+        delete prefetchers[1];
+        delete writeBuffer;
+        return EXIT_FAILURE;
+    }
+    // Performance model over CACTI numbers of every level (see perfmodel.h)
+    struct Levels {
+        const L1 *l1Cache;
+        const L2 *l2Cache;
+    } levels = {&l1Cache, l2Cache};
+    Performance perf = {0, 0, 0, 0};
+    CactiTable cacti;
+    HierarchyCost cost;
+    std::string error;
+    SimStats s(levels);
+    if (lookupHierarchyCost(cacti, cfg, cost, error)) perf = evaluatePerformance(cfg, s, cost);
+    else std::cerr << error << "; performance results are 0\n";
+
     std::cout<<"===== L1 contents =====\n";
     l1Cache.printContents();
     if(L2_SIZE)
@@ -103,33 +282,210 @@ int main(int argc, char *argv[]) {
     l1Cache.printVictimContents();
     }
     std::cout << "===== Simulation results (raw) =====\n";
-        std::cout << "  a. number of L1 reads:\t\t\t" << l1Cache.numReads << "\n";
-        std::cout << "  b. number of L1 read misses:\t\t\t" << l1Cache.numReadMisses << "\n";
-        std::cout << "  c. number of L1 writes:\t\t\t" << l1Cache.numWrites << "\n";
-        std::cout << "  d. number of L1 write misses:\t\t\t" << l1Cache.numWriteMisses << "\n";
-        std::cout << "  e. number of swap requests:\t\t\t" << l1Cache.numSwaps << "\n";
-        std::cout << "  f. swap request rate:\t\t\t\t" << std::fixed << std::setprecision(4) << (l1Cache.numReads + l1Cache.numWrites > 0 ? static_cast<double>(l1Cache.numSwaps) / (l1Cache.numReads + l1Cache.numWrites) : 0) << "\n";
-        std::cout << "  g. number of swaps:\t\t\t\t" << l1Cache.numSwaps << "\n";
-        std::cout << "  h. combined L1+VC miss rate:\t\t\t" << std::fixed << std::setprecision(4) << (l1Cache.numReads + l1Cache.numWrites > 0 ? static_cast<double>(l1Cache.numReadMisses + l1Cache.numWriteMisses - l1Cache.numSwaps) / (l1Cache.numReads + l1Cache.numWrites) : 0) << "\n";
-        std::cout << "  i. number writebacks from L1/VC:\t\t" << l1Cache.numWritebacks << "\n";
-        std::cout << "  j. number of L2 reads:\t\t\t" << (L2_SIZE?l2Cache->numReads:0) << "\n";
-        std::cout << "  k. number of L2 read misses:\t\t\t" << (L2_SIZE?l2Cache->numReadMisses:0) << "\n";
-        std::cout << "  l. number of L2 writes:\t\t\t" << (L2_SIZE?l2Cache->numWrites:0) << "\n";
-        std::cout << "  m. number of L2 write misses:\t\t\t" <<(L2_SIZE?l2Cache->numWriteMisses:0) << "\n";
-        std::cout << "  n. L2 miss rate:\t\t\t\t" << std::fixed << std::setprecision(4) << (L2_SIZE?(l2Cache->numReads > 0 ? static_cast<double>(l2Cache->numReadMisses) / l2Cache->numReads : 0):0) << "\n";
-        std::cout << "  o. number of writebacks from L2:\t\t" << (L2_SIZE?l2Cache->numWritebacks :0) << "\n";
-        std::cout << "  p. total memory traffic:\t\t\t" << (L2_SIZE?(l2Cache->numReads + l2Cache->numWrites + l2Cache->numWritebacks) :0)<< "\n";
+        std::cout << "  a. number of L1 reads:\t\t\t" << s.l1Reads << "\n";
+        std::cout << "  b. number of L1 read misses:\t\t\t" << s.l1ReadMisses << "\n";
+        std::cout << "  c. number of L1 writes:\t\t\t" << s.l1Writes << "\n";
+        std::cout << "  d. number of L1 write misses:\t\t\t" << s.l1WriteMisses << "\n";
+        std::cout << "  e. number of swap requests:\t\t\t" << s.swapRequests << "\n";
+        std::cout << "  f. swap request rate:\t\t\t\t" << std::fixed << std::setprecision(4) << s.swapRequestRate() << "\n";
+        std::cout << "  g. number of swaps:\t\t\t\t" << s.swaps << "\n";
+        std::cout << "  h. combined L1+VC miss rate:\t\t\t" << std::fixed << std::setprecision(4) << s.l1MissRate() << "\n";
+        std::cout << "  i. number writebacks from L1/VC:\t\t" << s.l1Writebacks << "\n";
+        std::cout << "  j. number of L2 reads:\t\t\t" << s.l2Reads << "\n";
+        std::cout << "  k. number of L2 read misses:\t\t\t" << s.l2ReadMisses << "\n";
+        std::cout << "  l. number of L2 writes:\t\t\t" << s.l2Writes << "\n";
+        std::cout << "  m. number of L2 write misses:\t\t\t" << s.l2WriteMisses << "\n";
+        std::cout << "  n. L2 miss rate:\t\t\t\t" << std::fixed << std::setprecision(4) << s.l2MissRate() << "\n";
+        std::cout << "  o. number of writebacks from L2:\t\t" << s.l2Writebacks << "\n";
+        std::cout << "  p. total memory traffic:\t\t\t" << s.memoryTraffic() << "\n";
+    if (prefetchers[0] || prefetchers[1]) {
+        std::cout << "===== Prefetch statistics =====\n";
+        if (prefetchers[0]) printPrefetchStats("L1", *prefetchers[0], l1Cache.numReadMisses + l1Cache.numWriteMisses);
+        if (prefetchers[1]) printPrefetchStats("L2", *prefetchers[1], l2Cache->numReadMisses + l2Cache->numWriteMisses);
+    }
+    if (writeBuffer) {
+        std::cout << "===== Write buffer =====\n";
+        printWriteBufferStats(*writeBuffer, s.memoryTraffic() + s.coalescedWrites);
+    }
     // Print statistics
     // if (VC_NUM_BLOCKS>0) l1Cache.printVictimStatistics();
     // if (l2Cache) l2Cache->printStatistics();
         
     std::cout<<"===== Simulation results (performance) =====\n" ;
-    std::cout<<"1. average access time:\t\t\t"<<L1accessTime<<std::endl;
-    std::cout<<"2. energy-delay product:\t\t\t"<<L1Energy<<std::endl;
-    std::cout<<"3. total area:\t\t\t"<<L1Area<<std::endl;
+    std::cout<<"1. average access time:\t\t\t"<<perf.aat<<std::endl;
+    std::cout<<"2. energy-delay product:\t\t\t"<<perf.edp<<std::endl;
+    std::cout<<"3. total area:\t\t\t"<<perf.area<<std::endl;
+    if (l1Classes) {
+        std::cout << "===== Miss classification (3C) =====\n";
+        printMissClasses("L1", *l1Classes);
+        if (l2Classes) printMissClasses("L2", *l2Classes);
+    }
+    delete l1Classes;
+    delete l2Classes;
+    delete prefetchers[0];
+    delete prefetchers[1];
+    delete writeBuffer;
+    return 0;
+}
+
+// Simulate one configuration with the given replacement policy and print
+// the contents and statistics
+template <class Policy>
+int runSimulation(int L1_SIZE, int L1_ASSOC, int L1_BLOCKSIZE, int VC_NUM_BLOCKS, int L2_SIZE, int L2_ASSOC,
+                  const std::string &trace_file, const SimOptions &options) {
+    if (options.sampled()) {
+        // Estimates only, from a partial simulation
+        if (options.classify || options.checkpointing() || options.prefetching() || !options.defaultWrites() ||
+            (options.sampling.sets > 0 && options.sampling.period > 0)) {
+            std::cerr << "Sampled simulation takes one of --sample-sets and --sample-time, and no --classify, --prefetch,"
+                         " --write-policy, --write-buffer or checkpoints\n";
+            return EXIT_FAILURE;
+        }
+        CacheConfig cfg = {L1_SIZE, L1_ASSOC, L1_BLOCKSIZE, VC_NUM_BLOCKS, L2_SIZE, L2_ASSOC};
+        return runSampling<Policy>(cfg, trace_file, options.sampling);
+    }
+
+    // Binary traces (see trace_convert) are replayed straight from an mmap,
+    // compacted ones a run at a time; text (or .gz) traces are decoded on
+    // a producer thread while this thread simulates, a batch at a time.
+    // Accesses [position, stopAt) are simulated and position is advanced
+    // past them.
+    uint64_t position = 0;
+    auto replay = [&](auto &l1Cache) {
+        return [&]() {
+            return forEachTraceRun(trace_file, [&](const Access *records, size_t n) {
+                l1Cache.handleBatch(records, n);
+                position += n;
+            }, [&](unsigned long address, uint32_t ops, int repeat) {
+                l1Cache.handleRun(address, ops, repeat);
+                position += repeat;
+            }, position, options.stopAt);
+        };
+    };
+
+    // (the fully associative shadow of --classify, prefetches and the
+    // write buffer span all sets, so they rule out sharding; checkpoints
+    // are taken of the serial hierarchy)
+    bool sharded = !options.classify && !options.prefetching() && !options.checkpointing() && options.writeBuffer == 0 &&
+                   shardingSupported(Policy::setLocal, VC_NUM_BLOCKS, L2_SIZE, options.shards);
+    if (!sharded && !(L2_SIZE > 0 && options.pipelineL2 && !options.checkpointing())) {
+        if (options.shards > 1) {
+            std::cerr << "Set-sharded simulation needs a single level without VC, a set-local"
+                         " replacement policy and no --classify, --prefetch, --write-buffer or checkpoints; simulating serially\n";
+        }
+        // One thread: the hierarchy is a single compile-time composed type
+        // for its shape, so L1 -> VC -> L2 calls inline (see composed.h)
+        CacheConfig cfg = {L1_SIZE, L1_ASSOC, L1_BLOCKSIZE, VC_NUM_BLOCKS, L2_SIZE, L2_ASSOC};
+        return dispatchComposedShape<Policy>(cfg, [&](auto *tag) {
+            typedef typename std::remove_pointer<decltype(tag)>::type H;
+            H *h = new H(cfg);
+            std::string error;
+            if (!options.restoreState.empty()) {
+                if (!loadCheckpoint(options.restoreState, *h, Policy::name(), trace_file, position, error)) {
+                    std::cerr << error << "\n";
+                    delete h;
+                    return EXIT_FAILURE;
+                }
+                if (options.classify || options.prefetching() || options.writeBuffer > 0) {
+                    std::cerr << "Miss classification, prefetchers and the write buffer start cold at the restored trace position "
+                              << position << "\n";
+                }
+            }
+            int status = simulateAndPrint(*h->l1Cache, h->l2Cache, cfg, options, [&]() {
+                if (!replay(*h->l1Cache)()) return false;
+                if (!options.saveState.empty() && !saveCheckpoint(options.saveState, *h, Policy::name(), trace_file, position, error)) {
+                    std::cerr << error << "\n";
+                    return false;
+                }
+                return true;
+            });
+            delete h;
+            return status;
+        });
+    }
+
+    // Initialize L1 Cache
+    BasicCache<Policy> *l2Cache = nullptr;
+    if (L2_SIZE > 0) {
+        l2Cache = new BasicCache<Policy>(L2_SIZE, L2_ASSOC, L1_BLOCKSIZE);
+    }
+    BasicCache<Policy> l1Cache(L1_SIZE, L1_ASSOC, L1_BLOCKSIZE,l2Cache,VC_NUM_BLOCKS);
+    CacheConfig cfg = {L1_SIZE, L1_ASSOC, L1_BLOCKSIZE, VC_NUM_BLOCKS, L2_SIZE, L2_ASSOC};
+
+    int status;
+    if (sharded) {
+        // Disjoint set ranges simulated on separate threads
+        status = simulateAndPrint(l1Cache, l2Cache, cfg, options, [&]() {
+            return simulateSharded(l1Cache, L1_ASSOC, L1_BLOCKSIZE, trace_file, options.shards);
+        });
+    } else {
+        // L1+VC on this thread, L2 on its own thread consuming L1's
+        // ordered miss stream
+        status = simulateAndPrint(l1Cache, l2Cache, cfg, options, [&]() {
+            EventQueue l2Queue;
+            l1Cache.setNextLevelQueue(&l2Queue);
+            std::thread l2Thread([&]() { consumeEvents(l2Queue, *l2Cache); });
+            bool ok = replay(l1Cache)();
+            l2Queue.close();
+            l2Thread.join();
+            l1Cache.setNextLevelQueue(nullptr);
+            return ok;
+        });
+    }
     // Clean up
-    // if (l1VictimCache) delete l1VictimCache;
     if (l2Cache) delete l2Cache;
     
-    return 0;
+    return status;
+}
+
+// One simulator instantiation per replacement policy, selected by --policy
+struct SimPolicy {
+    const char *name;
+    int (*run)(int, int, int, int, int, int, const std::string &, const SimOptions &);
+    bool (*supports)(int);
+};
+
+static const SimPolicy simPolicies[] = {
+    {LRUPolicy::name(), runSimulation<LRUPolicy>, LRUPolicy::supports},
+    {TreePLRUPolicy::name(), runSimulation<TreePLRUPolicy>, TreePLRUPolicy::supports},
+    {SRRIPPolicy::name(), runSimulation<SRRIPPolicy>, SRRIPPolicy::supports},
+    {BRRIPPolicy::name(), runSimulation<BRRIPPolicy>, BRRIPPolicy::supports},
+    {RandomPolicy::name(), runSimulation<RandomPolicy>, RandomPolicy::supports},
+};
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--sweep") {
+        return runSweep(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--optimize") {
+        return runOptimize(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--stackdist") {
+        return runStackDistance(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--multicore") {
+        return runMulticore(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--stream") {
+        return runStream(argc, argv);
+    }
+
+    // Parse command-line arguments
+    int L1_SIZE, L1_ASSOC, L1_BLOCKSIZE, VC_NUM_BLOCKS, L2_SIZE, L2_ASSOC;
+    std::string trace_file;
+    SimOptions options;
+    parseArguments(argc, argv, L1_SIZE, L1_ASSOC, L1_BLOCKSIZE, VC_NUM_BLOCKS, L2_SIZE, L2_ASSOC, trace_file, options);
+    if (!traceSupportsBlockSize(trace_file, L1_BLOCKSIZE)) return EXIT_FAILURE;
+
+    for (const SimPolicy &p : simPolicies) {
+        if (options.policy != p.name) continue;
+        if (!p.supports(L1_ASSOC) || (L2_SIZE > 0 && !p.supports(L2_ASSOC))) {
+            std::cerr << "Replacement policy " << options.policy << " does not support this associativity\n";
+            return EXIT_FAILURE;
+        }
+        return p.run(L1_SIZE, L1_ASSOC, L1_BLOCKSIZE, VC_NUM_BLOCKS, L2_SIZE, L2_ASSOC, trace_file, options);
+    }
+    std::cerr << "Unknown replacement policy: " << options.policy << "\n";
+    return EXIT_FAILURE;
 }
+
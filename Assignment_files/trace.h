@@ -0,0 +1,283 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+///////////////////////////////////////////////////////////////////////////
+// Packed binary trace format
+//
+//    TraceHeader (32 bytes), followed by numRecords 8-byte records.
+//
+//    Each record holds (value << 1) | op, where op is 0 for a read and
+//    1 for a write. Without TRACE_DELTA, value is the address itself.
+//    With TRACE_DELTA, value is the zigzag-encoded difference from the
+//    previous record's address (the first record is relative to 0).
+//    Addresses therefore must fit in 63 bits; TraceWriter refuses wider ones.
+//
+//    With TRACE_COMPACT (trace_convert -c BLOCKSIZE) the records are
+//    16-byte TraceRuns instead, each a run of up to TRACE_RUN_MAX
+//    consecutive accesses to one block of blockSize bytes. Replaying it
+//    at any block size that is a multiple of blockSize gives the same
+//    statistics as the original trace, with every run simulated as one
+//    event (see CacheLevel::handleRun).
+///////////////////////////////////////////////////////////////////////////
+
+#define TRACE_MAGIC "CSTB"
+#define TRACE_VERSION 1
+#define TRACE_DELTA 0x1
+#define TRACE_COMPACT 0x2
+#define TRACE_RUN_MAX 32
+
+struct TraceHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t blockSize; // of a TRACE_COMPACT trace, else 0
+    uint64_t numRecords;
+    uint64_t reserved2;
+};
+
+// One record of a TRACE_COMPACT trace
+struct TraceRun {
+    uint64_t block;  // address / blockSize
+    uint32_t ops;    // bit i set if access i of the run is a write
+    uint32_t repeat; // accesses in the run, 1..TRACE_RUN_MAX
+};
+
+// One decoded trace record
+struct Access {
+    unsigned long address;
+    char type; // 'r' or 'w'
+};
+
+inline uint64_t zigzagEncode(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+inline int64_t zigzagDecode(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+// Parse one "r <hex>" / "w <hex>" text line. Returns false on a blank or
+// malformed line; type is set to the op character either way.
+inline bool parseTraceLine(const char *line, char &type, unsigned long &address) {
+    while (*line == ' ' || *line == '\t') line++;
+    type = *line;
+    if (type == '\0' || type == '\n' || type == '\r') return false;
+    line++;
+    char *end;
+    address = strtoul(line, &end, 16);
+    return end != line;
+}
+
+// True if the file at path starts with the binary trace magic
+inline bool isBinaryTrace(const char *path) {
+    char magic[4];
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+    bool ok = fread(magic, 1, 4, f) == 4 && memcmp(magic, TRACE_MAGIC, 4) == 0;
+    fclose(f);
+    return ok;
+}
+
+// Block size the binary trace at path was compacted at (TRACE_COMPACT),
+// 0 for any other trace
+inline uint32_t traceCompactBlockSize(const char *path) {
+    TraceHeader h;
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    bool ok = fread(&h, sizeof(h), 1, f) == 1 && memcmp(h.magic, TRACE_MAGIC, 4) == 0;
+    fclose(f);
+    return ok && (h.flags & TRACE_COMPACT) ? h.blockSize : 0;
+}
+
+// Read-only mmap of a binary trace. Records are decoded in place while
+// iterating, nothing is copied out of the mapping.
+class MappedTrace {
+private:
+    void *base;
+    size_t length;
+
+public:
+    const TraceHeader *header;
+    const uint64_t *records;
+    uint64_t numRecords;
+
+    MappedTrace() : base(nullptr), length(0), header(nullptr), records(nullptr), numRecords(0) {}
+    ~MappedTrace() { close(); }
+
+    bool open(const char *path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TraceHeader)) {
+            ::close(fd);
+            return false;
+        }
+        length = st.st_size;
+        base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            base = nullptr;
+            return false;
+        }
+        madvise(base, length, MADV_SEQUENTIAL);
+        header = (const TraceHeader *)base;
+        if (memcmp(header->magic, TRACE_MAGIC, 4) != 0 || header->version != TRACE_VERSION ||
+            header->numRecords > (length - sizeof(TraceHeader)) / sizeof(uint64_t)) {
+            close();
+            return false;
+        }
+        records = (const uint64_t *)((const char *)base + sizeof(TraceHeader));
+        numRecords = header->numRecords;
+        if (isCompact() && (header->blockSize == 0 || numRecords > (length - sizeof(TraceHeader)) / sizeof(TraceRun))) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (base) munmap(base, length);
+        base = nullptr;
+        header = nullptr;
+        records = nullptr;
+        numRecords = 0;
+    }
+
+    bool isDelta() const { return header->flags & TRACE_DELTA; }
+    bool isCompact() const { return header->flags & TRACE_COMPACT; }
+
+    // Call f(address, ops, repeat) for the runs of a TRACE_COMPACT trace,
+    // cut down to accesses [first, end); address is the block's first byte
+    template <class F>
+    void forEachRun(F f, uint64_t first = 0, uint64_t end = UINT64_MAX) const {
+        const TraceRun *runs = (const TraceRun *)records;
+        uint64_t position = 0;
+        for (uint64_t i = 0; i < numRecords && position < end; ++i) {
+            TraceRun r = runs[i];
+            uint64_t runEnd = position + r.repeat;
+            if (runEnd > first) {
+                uint32_t skip = position < first ? first - position : 0;
+                uint32_t repeat = (runEnd < end ? runEnd : end) - position - skip;
+                f((unsigned long)(r.block * header->blockSize), r.ops >> skip, (int)repeat);
+            }
+            position = runEnd;
+        }
+    }
+
+    // Call f(type, address) for accesses [first, end) in order, type being
+    // 'r' or 'w'. Without TRACE_DELTA the prefix is skipped outright; with
+    // it the skipped deltas still have to be summed.
+    template <class F>
+    void forEach(F f, uint64_t first = 0, uint64_t end = UINT64_MAX) const {
+        if (isCompact()) {
+            forEachRun([&](unsigned long address, uint32_t ops, int repeat) {
+                for (int k = 0; k < repeat; ++k) f(((ops >> k) & 1) ? 'w' : 'r', address);
+            }, first, end);
+            return;
+        }
+        if (end > numRecords) end = numRecords;
+        if (isDelta()) {
+            uint64_t address = 0;
+            for (uint64_t i = 0; i < first && i < end; ++i) address += (uint64_t)zigzagDecode(records[i] >> 1);
+            for (uint64_t i = first; i < end; ++i) {
+                uint64_t rec = records[i];
+                address += (uint64_t)zigzagDecode(rec >> 1);
+                f((rec & 1) ? 'w' : 'r', (unsigned long)address);
+            }
+        } else {
+            for (uint64_t i = first; i < end; ++i) {
+                uint64_t rec = records[i];
+                f((rec & 1) ? 'w' : 'r', (unsigned long)(rec >> 1));
+            }
+        }
+    }
+};
+
+// Writes records to a binary trace file, patching the count in on close
+class TraceWriter {
+private:
+    FILE *out;
+    bool delta;
+    uint32_t blockSize; // > 0 for TRACE_COMPACT
+    uint64_t count;
+    uint64_t prev;
+    uint64_t runs;
+    TraceRun run; // being extended, unless run.repeat is 0
+    bool wide;    // an address or delta did not fit in a 63-bit record value
+
+    void flushRun() {
+        if (run.repeat == 0) return;
+        fwrite(&run, sizeof(run), 1, out);
+        runs++;
+        run.repeat = 0;
+    }
+
+public:
+    TraceWriter() : out(nullptr), delta(false), blockSize(0), count(0), prev(0), runs(0), run{0, 0, 0}, wide(false) {}
+    ~TraceWriter() { close(); }
+
+    // compactBlockSize > 0 writes a TRACE_COMPACT trace of runs at that
+    // block size instead of one record per access
+    bool open(const char *path, bool deltaEncode, uint32_t compactBlockSize = 0) {
+        out = fopen(path, "wb");
+        if (!out) return false;
+        delta = deltaEncode && compactBlockSize == 0;
+        blockSize = compactBlockSize;
+        TraceHeader h;
+        memset(&h, 0, sizeof(h));
+        fwrite(&h, sizeof(h), 1, out); // placeholder until the count is known
+        return true;
+    }
+
+    void write(char type, unsigned long address) {
+        if (blockSize) {
+            uint64_t block = address / blockSize;
+            if (run.repeat == TRACE_RUN_MAX || (run.repeat > 0 && run.block != block)) flushRun();
+            if (run.repeat == 0) run = TraceRun{block, 0, 0};
+            if (type == 'w') run.ops |= 1U << run.repeat;
+            run.repeat++;
+            count++;
+            return;
+        }
+        uint64_t value = delta ? zigzagEncode((int64_t)(address - prev)) : address;
+        if ((address | value) >> 63) {
+            wide = true; // the shift below would drop bit 63; close() fails
+            return;
+        }
+        uint64_t rec = (value << 1) | (type == 'w' ? 1 : 0);
+        prev = address;
+        fwrite(&rec, sizeof(rec), 1, out);
+        count++;
+    }
+
+    // Accesses written, and records (runs of a TRACE_COMPACT trace)
+    uint64_t written() const { return count; }
+    uint64_t records() const { return blockSize ? runs : count; }
+    // Whether write() was given an address it cannot encode (see above)
+    bool wideAddress() const { return wide; }
+
+    bool close() {
+        if (!out) return true;
+        if (blockSize) flushRun();
+        TraceHeader h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, TRACE_MAGIC, 4);
+        h.version = TRACE_VERSION;
+        h.flags = (delta ? TRACE_DELTA : 0) | (blockSize ? TRACE_COMPACT : 0);
+        h.blockSize = blockSize;
+        h.numRecords = records();
+        bool ok = fseek(out, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, out) == 1;
+        // A failed record fwrite in write() or flushRun() leaves the error flag
+        // set, and a record write() could not encode leaves wide set
+        ok = ok && !ferror(out) && !wide;
+        ok = (fclose(out) == 0) && ok;
+        out = nullptr;
+        return ok;
+    }
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include <iostream>
+#include <string>
+#include "trace.h"
+#include "pipeline.h"
+
+// Convert a text trace ("r <hex>" / "w <hex>" per line) into the packed
+// binary format read by cache_sim (see trace.h)
+int main(int argc, char *argv[]) {
+    bool delta = false;
+    int compactBlockSize = 0;
+    int argi = 1;
+    for (; argi < argc; ++argi) {
+        std::string arg = argv[argi];
+        if (arg == "-d") delta = true;
+        else if (arg == "-c" && argi + 1 < argc) compactBlockSize = atoi(argv[++argi]);
+        else break;
+    }
+    if (argc - argi != 2 || compactBlockSize < 0 || (compactBlockSize > 0 && delta)) {
+        std::cerr << "Usage: " << argv[0] << " [-d | -c BLOCKSIZE] <text_trace[.gz]> <binary_trace>\n";
+        std::cerr << "  -d            delta-encode addresses\n";
+        std::cerr << "  -c BLOCKSIZE  compact into runs of accesses to one BLOCKSIZE block\n";
+        return EXIT_FAILURE;
+    }
+
+    // .gz inputs are decompressed on the fly
+    TracePipeline trace;
+    if (!trace.open(argv[argi])) {
+        std::cerr << "Error opening trace file: " << argv[argi] << "\n";
+        return EXIT_FAILURE;
+    }
+    TraceWriter writer;
+    if (!writer.open(argv[argi + 1], delta, compactBlockSize)) {
+        std::cerr << "Error creating output file: " << argv[argi + 1] << "\n";
+        return EXIT_FAILURE;
+    }
+    if (!trace.forEach([&](char type, unsigned long address) { writer.write(type, address); })) {
+        std::cerr << trace.getError() << "\n";
+        return EXIT_FAILURE;
+    }
+    if (!writer.close()) {
+        if (writer.wideAddress()) std::cerr << "An address or address delta does not fit in 63 bits; ";
+        std::cerr << "Error writing output file: " << argv[argi + 1] << "\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << "Converted " << writer.written() << " accesses";
+    if (compactBlockSize) std::cout << " into " << writer.records() << " runs";
+    std::cout << "\n";
+    return 0;
+}
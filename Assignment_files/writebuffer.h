@@ -0,0 +1,64 @@
+#ifndef WRITEBUFFER_H
+#define WRITEBUFFER_H
+
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////
+// Coalescing write buffer between the last cache level and memory
+//
+//    cache_sim --write-buffer N ...
+//
+//    Every block the last level writes to memory (a dirty writeback, a
+//    write-through or a write-around) enters a FIFO of N block-sized
+//    entries. A write to a block that is already waiting merges into its
+//    entry; when a new block finds the buffer full, the oldest entry is
+//    written to memory. The merged writes are the memory traffic the
+//    buffer saves. Reads are not modelled: they never wait for, or are
+//    served from, the buffer.
+///////////////////////////////////////////////////////////////////////////
+
+struct WriteBufferStats {
+    long writes;    // blocks the cache wrote into the buffer
+    long coalesced; // of those, merged into a waiting entry
+    long drained;   // entries written to memory so far
+};
+
+class WriteBuffer {
+private:
+    std::vector<unsigned long> entries; // ring of waiting block numbers
+    int head;                           // oldest entry
+    int count;
+
+public:
+    WriteBufferStats stats;
+
+    explicit WriteBuffer(int numEntries)
+        : entries(numEntries > 0 ? numEntries : 1), head(0), count(0), stats{0, 0, 0} {}
+
+    int size() const { return (int)entries.size(); }
+
+    // The cache writes block to memory
+    void write(unsigned long block) {
+        stats.writes++;
+        int n = size();
+        for (int i = 0, slot = head; i < count; ++i, slot = slot + 1 == n ? 0 : slot + 1) {
+            if (entries[slot] == block) {
+                stats.coalesced++;
+                return;
+            }
+        }
+        if (count == n) {
+            stats.drained++;
+            head = head + 1 == n ? 0 : head + 1;
+            count--;
+        }
+        int tail = head + count;
+        entries[tail >= n ? tail - n : tail] = block;
+        count++;
+    }
+
+    // Writes memory sees once the buffer has drained
+    long memoryWrites() const { return stats.writes - stats.coalesced; }
+};
+
+#endif